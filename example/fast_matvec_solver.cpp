@@ -100,8 +100,33 @@ int main( int argc, char *argv[] )
   /** [Step#8] Solve (K+lambda*I)w = u approximately with HSS. */
   auto x2 = u2;
   gofmm::Solve( tree2, x2 ); 
+  /** [Step#9] Evaluate K( X_new, X ) * w2 for new points X_new. */
+  size_t n_new = 500;
+  Data<T> X_new( d, n_new ); X_new.randn();
+  kernel_s<T, T> kernel;
+  kernel.type = GAUSSIAN;
+  kernel.scal = -0.5;
+  KernelMatrix<T> K2_new( n_new, n, d, kernel, X, X_new );
+  auto u2_new = gofmm::OutOfSampleEvaluate( tree2, K2_new, w2 );
+  /** Compare with the dense K( X_new, X ) * w2. */
+  vector<size_t> I_new( n_new ), J_all( n );
+  for ( size_t i = 0; i < n_new; i ++ ) I_new[ i ] = i;
+  for ( size_t j = 0; j < n; j ++ ) J_all[ j ] = j;
+  auto K2_new_dense = K2_new( I_new, J_all );
+  Data<T> u2_new_dense( n_new, nrhs, 0.0 );
+  xgemm( "N", "N", n_new, nrhs, n, 
+    1.0, K2_new_dense.data(), n_new, w2.data(), n, 
+    0.0, u2_new_dense.data(), n_new );
+  T err2 = 0.0, nrm2 = 0.0;
+  for ( size_t i = 0; i < u2_new.size(); i ++ )
+  {
+    T diff = u2_new[ i ] - u2_new_dense[ i ];
+    err2 += diff * diff;
+    nrm2 += u2_new_dense[ i ] * u2_new_dense[ i ];
+  }
+  printf( "Out-of-sample relative error %3.1E\n", std::sqrt( err2 / nrm2 ) );
 
-  /** [Step#9] HMLP API call to terminate the runtime. */
+  /** [Step#10] HMLP API call to terminate the runtime. */
   hmlp_finalize();
 
   return 0;
@@ -0,0 +1,134 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *  
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/  
+
+/** Use GOFMM templates. */
+#include <gofmm.hpp>
+/** Use implicit kernel matrices (only coordinates are stored). */
+#include <containers/KernelMatrix.hpp>
+/** Use STL and HMLP namespaces. */
+using namespace std;
+using namespace hmlp;
+
+
+/** @brief Relative error of u( rows, : ) against the dense K( rows, : ) * w. */
+template<typename T>
+T DenseError( KernelMatrix<T> &K, Data<T> &w, Data<T> &u, vector<size_t> &rows )
+{
+  size_t n = K.col(), nrhs = w.col();
+  vector<size_t> cols( n );
+  for ( size_t j = 0; j < n; j ++ ) cols[ j ] = j;
+  auto Kdense = K( rows, cols );
+  Data<T> udense( rows.size(), nrhs, 0.0 );
+  xgemm( "N", "N", rows.size(), nrhs, n, 
+    1.0, Kdense.data(), rows.size(), w.data(), n, 
+    0.0, udense.data(), rows.size() );
+  T err2 = 0.0, nrm2 = 0.0;
+  for ( size_t j = 0; j < nrhs; j ++ )
+  {
+    for ( size_t i = 0; i < rows.size(); i ++ )
+    {
+      T diff = u( rows[ i ], j ) - udense( i, j );
+      err2 += diff * diff;
+      nrm2 += udense( i, j ) * udense( i, j );
+    }
+  }
+  return std::sqrt( err2 / nrm2 );
+}; /** end DenseError() */
+
+
+/** 
+ *  @brief In this example, we remove and reinsert points of a compressed
+ *         kernel matrix and check the updated tree against dense matvecs.
+ *         Removed points carry zero weights in the reference.
+ */ 
+int main( int argc, char *argv[] )
+{
+  /** Use double as data type. */
+  using T = double;
+  /** [Required] Problem size. */
+  size_t n = 8192;
+  /** Maximum leaf node size. */
+  size_t m = 128;
+  /** [Required] Number of nearest neighbors. */
+  size_t k = 32;
+  /** Maximum off-diagonal rank. */
+  size_t s = 128;
+  /** Approximation tolerance. */
+  T stol = 1E-5;
+  /** The amount of direct evaluation. */
+  T budget = 0.01;
+  /** Number of right-hand sides. */
+  size_t nrhs = 4;
+  /** Dimension of the point cloud. */
+  size_t d = 3;
+
+  /** [Step#0] HMLP API call to initialize the runtime. */
+  hmlp_init( &argc, &argv );
+
+  /** [Step#1] Compress a Gaussian kernel matrix with random 3D data. */
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, stol, budget );
+  Data<T> X( d, n ); X.randn();
+  KernelMatrix<T> K( X );
+  gofmm::randomsplit<KernelMatrix<T>, 2, T> rkdtsplitter( K );
+  gofmm::centersplit<KernelMatrix<T>, 2, T> splitter( K );
+  auto neighbors = gofmm::FindNeighbors( K, rkdtsplitter, config );
+  auto* tree_ptr = gofmm::Compress( K, neighbors, splitter, rkdtsplitter, config );
+  auto& tree = *tree_ptr;
+
+  /** [Step#2] Check a sample of rows against the dense matvec. */
+  Data<T> w( n, nrhs ); w.randn();
+  vector<size_t> rows;
+  for ( size_t i = 0; i < n; i += 37 ) rows.push_back( i );
+  auto u = gofmm::Evaluate( tree, w );
+  printf( "Compressed tree relative error %3.1E\n", DenseError( K, w, u, rows ) );
+
+  /** [Step#3] Remove 1% of the points scattered over the domain. */
+  vector<size_t> removed;
+  for ( size_t i = 0; i < n; i += 100 ) removed.push_back( i );
+  gofmm::RemovePoints( tree, removed );
+  Data<T> w_removed = w;
+  for ( auto i : removed )
+    for ( size_t j = 0; j < nrhs; j ++ ) w_removed( i, j ) = 0.0;
+  vector<size_t> rows_kept;
+  for ( auto i : rows ) if ( i % 100 ) rows_kept.push_back( i );
+  u = gofmm::Evaluate( tree, w_removed );
+  printf( "After removal relative error %3.1E\n", 
+      DenseError( K, w_removed, u, rows_kept ) );
+
+  /** [Step#4] Reinsert these points (duplicates are skipped). */
+  removed.push_back( removed.front() );
+  gofmm::InsertPoints( tree, removed );
+  u = gofmm::Evaluate( tree, w );
+  printf( "After insertion relative error %3.1E\n", DenseError( K, w, u, rows ) );
+
+  /** [Step#5] Localized updates only dirty a few subtrees. */
+  vector<size_t> corner;
+  for ( size_t i = 0; i < n; i ++ ) if ( X( 0, i ) > 2.0 ) corner.push_back( i );
+  gofmm::RemovePoints( tree, corner );
+  gofmm::InsertPoints( tree, corner );
+  u = gofmm::Evaluate( tree, w );
+  printf( "After localized update relative error %3.1E\n", DenseError( K, w, u, rows ) );
+
+  /** [Step#6] HMLP API call to terminate the runtime. */
+  delete tree_ptr;
+  hmlp_finalize();
+
+  return 0;
+}; /** end main() */
@@ -0,0 +1,145 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *  
+ *  Copyright (C) 2014-2018, The University of Texas at Austin
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/  
+
+/** Use GOFMM templates. */
+#include <gofmm.hpp>
+/** Use implicit kernel matrices (only coordinates are stored). */
+#include <containers/KernelMatrix.hpp>
+/** Use STL and HMLP namespaces. */
+using namespace std;
+using namespace hmlp;
+
+
+/** @brief Relative error of u( rows, : ) against the dense K( rows, : ) * w. */
+template<typename T>
+T DenseError( KernelMatrix<T> &K, Data<T> &w, Data<T> &u, vector<size_t> &rows )
+{
+  size_t n = K.col(), nrhs = w.col();
+  vector<size_t> cols( n );
+  for ( size_t j = 0; j < n; j ++ ) cols[ j ] = j;
+  auto Kdense = K( rows, cols );
+  Data<T> udense( rows.size(), nrhs, 0.0 );
+  xgemm( "N", "N", rows.size(), nrhs, n, 
+    1.0, Kdense.data(), rows.size(), w.data(), n, 
+    0.0, udense.data(), rows.size() );
+  T err2 = 0.0, nrm2 = 0.0;
+  for ( size_t j = 0; j < nrhs; j ++ )
+  {
+    for ( size_t i = 0; i < rows.size(); i ++ )
+    {
+      T diff = u( rows[ i ], j ) - udense( i, j );
+      err2 += diff * diff;
+      nrm2 += udense( i, j ) * udense( i, j );
+    }
+  }
+  return std::sqrt( err2 / nrm2 );
+}; /** end DenseError() */
+
+
+
+/** 
+ *  @brief In this example, we compress and evaluate the same kernel matrix 
+ *         under each task scheduling policy of the runtime and report the
+ *         wall-clock time of both phases. Usage:
+ *
+ *         ./scheduling_policies.x [n] [repeats]
+ */ 
+int main( int argc, char *argv[] )
+{
+  /** Use double as data type. */
+  using T = double;
+  /** [Required] Problem size. */
+  size_t n = 8192;
+  /** Maximum leaf node size. */
+  size_t m = 128;
+  /** [Required] Number of nearest neighbors. */
+  size_t k = 32;
+  /** Maximum off-diagonal rank. */
+  size_t s = 128;
+  /** Approximation tolerance. */
+  T stol = 1E-5;
+  /** The amount of direct evaluation. */
+  T budget = 0.01;
+  /** Number of right-hand sides. */
+  size_t nrhs = 128;
+  /** Dimension of the point cloud. */
+  size_t d = 3;
+  /** Number of runs per policy (the fastest one is reported). */
+  size_t repeats = 3;
+  if ( argc > 1 ) sscanf( argv[ 1 ], "%lu", &n );
+  if ( argc > 2 ) sscanf( argv[ 2 ], "%lu", &repeats );
+
+  /** [Step#0] HMLP API call to initialize the runtime. */
+  hmlp_init( &argc, &argv );
+
+  /** [Step#1] A Gaussian kernel matrix with random 3D data. */
+  gofmm::Configuration<T> config( GEOMETRY_DISTANCE, n, m, k, s, stol, budget );
+  Data<T> X( d, n ); X.randn();
+  KernelMatrix<T> K( X );
+  gofmm::randomsplit<KernelMatrix<T>, 2, T> rkdtsplitter( K );
+  gofmm::centersplit<KernelMatrix<T>, 2, T> splitter( K );
+  /** Neighbors do not depend on the policy; search them once. */
+  auto neighbors = gofmm::FindNeighbors( K, rkdtsplitter, config );
+  Data<T> w( n, nrhs ); w.randn();
+  vector<size_t> rows;
+  for ( size_t i = 0; i < n; i += 97 ) rows.push_back( i );
+
+  /** [Step#2] Sweep all policies (HMLP_SCHEDULE_POLICY only sets the default). */
+  vector<pair<const char*, TaskSchedulePolicy>> policies = 
+  {
+    { "heft", HMLP_TASK_SCHEDULE_HEFT },
+    { "cp",   HMLP_TASK_SCHEDULE_CRITICAL_PATH },
+    { "fifo", HMLP_TASK_SCHEDULE_FIFO }
+  };
+  vector<double> compress_time( policies.size(), 0.0 );
+  vector<double> evaluate_time( policies.size(), 0.0 );
+  vector<T> error( policies.size(), 0.0 );
+  for ( size_t p = 0; p < policies.size(); p ++ )
+  {
+    hmlp_set_schedule_policy( policies[ p ].second );
+    for ( size_t r = 0; r < repeats; r ++ )
+    {
+      double beg = omp_get_wtime();
+      auto *tree_ptr = gofmm::Compress( K, neighbors, splitter, rkdtsplitter, config );
+      double t_compress = omp_get_wtime() - beg;
+      beg = omp_get_wtime();
+      auto u = gofmm::Evaluate( *tree_ptr, w );
+      double t_evaluate = omp_get_wtime() - beg;
+      if ( r == 0 || t_compress < compress_time[ p ] ) compress_time[ p ] = t_compress;
+      if ( r == 0 || t_evaluate < evaluate_time[ p ] ) evaluate_time[ p ] = t_evaluate;
+      /** The policy must not change the result (up to rounding). */
+      if ( r == 0 ) error[ p ] = DenseError( K, w, u, rows );
+      delete tree_ptr;
+    }
+  }
+
+  /** [Step#3] Report the fastest run of each policy. */
+  printf( "%-6s %12s %12s %12s\n", "policy", "compress(s)", "evaluate(s)", "error" );
+  for ( size_t p = 0; p < policies.size(); p ++ )
+  {
+    printf( "%-6s %12.3lf %12.3lf %12.1E\n", policies[ p ].first, 
+        compress_time[ p ], evaluate_time[ p ], error[ p ] );
+  }
+
+  /** [Step#4] HMLP API call to terminate the runtime. */
+  hmlp_finalize();
+
+  return 0;
+}; /** end main() */
@@ -106,6 +106,59 @@ class managed_allocator
 #endif // ifdef HMLP_USE_CUDA
 
 
+/** numa related */
+#ifdef HMLP_USE_NUMA
+#include <numa.h>
+
+/**
+ *  @brief Allocate large buffers on the NUMA node of the calling thread.
+ *         Node buffers are allocated (and value-initialized) inside the
+ *         tasks of their owners, which are pinned to the socket of the
+ *         subtree, so pages are first touched locally. Small buffers
+ *         are not worth a page and simply use malloc.
+ */
+template<class T>
+class numa_allocator
+{
+  public:
+
+    typedef T value_type;
+
+    numa_allocator() {};
+
+    template<class U>
+    numa_allocator( const numa_allocator<U>& other ) {};
+
+    /** Buffers smaller than this use malloc (decided by n only). */
+    static bool IsLarge( size_t n )
+    {
+      /** numa_available() is a syscall; only query it once. */
+      static const bool has_numa = ( numa_available() >= 0 );
+      return has_numa && ( n * sizeof(T) >= ( 1 << 16 ) );
+    };
+
+    T* allocate( size_t n )
+    {
+      void *ptr = IsLarge( n ) ? numa_alloc_local( n * sizeof(T) ) : malloc( n * sizeof(T) );
+      if ( !ptr ) throw std::bad_alloc();
+      return static_cast<T*>( ptr );
+    }; /** end allocate() */
+
+    void deallocate( T* ptr, size_t n )
+    {
+      if ( IsLarge( n ) ) numa_free( ptr, n * sizeof(T) );
+      else free( ptr );
+    }; /** end deallocate() */
+};
+
+template<class T, class U>
+bool operator==( const numa_allocator<T>&, const numa_allocator<U>& ) { return true; };
+
+template<class T, class U>
+bool operator!=( const numa_allocator<T>&, const numa_allocator<U>& ) { return false; };
+#endif // ifdef HMLP_USE_NUMA
+
+
 
 
 
@@ -143,7 +196,16 @@ class Data : public ReadWrite, public vector<T, Allocator>
     Data() : vector<T, Allocator>(), m( 0 ), n( 0 ) {};
 
     /** Copy constructor for hmlp::Data. */
-    Data( const Data<T>& other_data ) : vector<T, Allocator>( other_data )
+    Data( const Data<T, Allocator>& other_data ) : vector<T, Allocator>( other_data )
+    {
+      this->m = other_data.row();
+      this->n = other_data.col();
+    }
+
+    /** Copy from hmlp::Data with a different allocator. */
+    template<class OtherAllocator>
+    Data( const Data<T, OtherAllocator>& other_data ) 
+      : vector<T, Allocator>( other_data.begin(), other_data.end() )
     {
       this->m = other_data.row();
       this->n = other_data.col();
@@ -570,6 +632,16 @@ class Data : public ReadWrite, public vector<T, Allocator>
 }; /** end class Data */
 
 
+#ifdef HMLP_USE_NUMA
+/** Buffers owned by a tree node are allocated on the socket of its owner. */
+template<class T>
+using LocalData = Data<T, numa_allocator<T> >;
+#else
+template<class T>
+using LocalData = Data<T>;
+#endif
+
+
 
 
 
@@ -215,6 +215,61 @@ inline void pack2Dimg
 
 
 
+/**
+ *  @brief Gather convolution windows of a batch of images directly into
+ *         a FOLD-wide micro-panel (implicit im2col). Column j0 + i is the
+ *         window ( j0 + i ) % ( nx * ny ) of image ( j0 + i ) / ( nx * ny ).
+ *         Rows are offset, ..., offset + n - 1 of the unfolded window.
+ *         NHWC images (and windows) are channel leading; NCHW images are
+ *         x leading and their windows are ordered as ( z, y, x ).
+ */ 
+template<int FOLD, bool NCHW, typename T>
+inline void pack2Dpatch
+(
+  int m, int n,                           // packing buffer size
+  T* packX,
+  size_t j0, int offset,                  // first window, first row
+  T *X,                                   // batch of images
+  int w0, int h0, int d0, int s, int p,   // Image size 
+  int w1, int h1
+)
+{
+  int nx = ( w0 - w1 + 2 * p ) / s + 1;
+  int ny = ( h0 - h1 + 2 * p ) / s + 1;
+  size_t nxy = (size_t)nx * ny;
+  size_t image_size = (size_t)w0 * h0 * d0;
+
+  for ( int i = 0; i < m; i ++ )
+  {
+    size_t b = ( j0 + i ) / nxy;
+    size_t r = ( j0 + i ) % nxy;
+    int x0 = ( r % nx ) * s - p;
+    int y0 = ( r / nx ) * s - p;
+    T *image = X + b * image_size;
+
+    for ( int j = 0; j < n; j ++ )
+    {
+      int q = offset + j, x, y, z;
+      if ( NCHW ) { x = q % w1; y = ( q / w1 ) % h1; z = q / ( w1 * h1 ); }
+      else        { z = q % d0; x = ( q / d0 ) % w1; y = ( q / d0 ) / w1; }
+      int x1 = x0 + x;
+      int y1 = y0 + y;
+
+      if ( 0 <= x1 && x1 < w0 && 0 <= y1 && y1 < h0 ) 
+      {
+        if ( NCHW ) packX[ j * FOLD + i ] = image[ ( z * h0 + y1 ) * w0 + x1 ];
+        else        packX[ j * FOLD + i ] = image[ ( y1 * w0 + x1 ) * d0 + z ];
+      }
+      else // zero-padding
+      {
+        packX[ j * FOLD + i ] = 0.0;
+      }
+    }
+  }
+}; // end pack2Dpatch()
+
+
+
 
 /**
  *  @brief This is the default packing routine for GKMX, GSKS, 
@@ -331,6 +386,60 @@ inline void pack2D
 }; // end pack2D()
 
 
+/**
+ *  @brief Pack the linear combination coef[ 0 ] * X[ 0 ] + ... of nx
+ *         operands that share the same ldx (fast matrix multiplication).
+ *         With NX > 0 the number of terms is a compile-time constant, and
+ *         the inner sum is fully unrolled; NX = 0 reads it from nx.
+ */
+template<bool TRANS, int FOLD, int NX, typename T>
+inline void pack2Dsum
+(
+  int m, int n,
+  int nx, T **X, int ldx, T *coef, T *packX
+)
+{
+  const int terms = NX ? NX : nx;
+
+  for ( int j = 0; j < n; j ++ )
+  {
+    for ( int i = 0; i < FOLD; i ++ )
+    {
+      /** Pad the fringe with the first row (or column). */
+      size_t offset = TRANS ? ( i < m ? i : 0 ) * (size_t)ldx + j
+                            : ( i < m ? i : 0 ) + (size_t)ldx * j;
+      T sum = coef[ 0 ] * X[ 0 ][ offset ];
+      for ( int t = 1; t < terms; t ++ ) sum += coef[ t ] * X[ t ][ offset ];
+      *packX ++ = sum;
+    }
+  }
+}; // end pack2Dsum()
+
+
+/**
+ *  @brief Dispatch the number of operands to an unrolled pack2Dsum.
+ */
+template<bool TRANS, int FOLD, typename T>
+inline void pack2Dsum
+(
+  int m, int n,
+  int nx, T **X, int ldx, T *coef, T *packX
+)
+{
+  switch ( nx )
+  {
+    case 1: pack2Dsum<TRANS, FOLD, 1>( m, n, nx, X, ldx, coef, packX ); break;
+    case 2: pack2Dsum<TRANS, FOLD, 2>( m, n, nx, X, ldx, coef, packX ); break;
+    case 3: pack2Dsum<TRANS, FOLD, 3>( m, n, nx, X, ldx, coef, packX ); break;
+    case 4: pack2Dsum<TRANS, FOLD, 4>( m, n, nx, X, ldx, coef, packX ); break;
+    case 6: pack2Dsum<TRANS, FOLD, 6>( m, n, nx, X, ldx, coef, packX ); break;
+    case 8: pack2Dsum<TRANS, FOLD, 8>( m, n, nx, X, ldx, coef, packX ); break;
+    default:
+      pack2Dsum<TRANS, FOLD, 0>( m, n, nx, X, ldx, coef, packX );
+  }
+}; // end pack2Dsum()
+
+
 
 /**
  *
@@ -332,6 +332,8 @@ void Task::Release()
 
 /** All virtual functions. */
 void Task::GetEventRecord() {};
+/** Most tasks set up their events in Set(); others shall override this. */
+double Task::SizeHint() { return event.GetFlops() + event.GetMops(); };
 void Task::Prefetch( Worker *user_worker ) {};
 void Task::DependencyAnalysis() {};
 
@@ -355,12 +357,20 @@ void Task::ForceEnqueue( size_t tid )
   rt.scheduler->ready_queue_lock[ assignment ].Acquire();
   {
     float cost = rt.workers[ assignment ].EstimateCost( this );
+    auto &queue = rt.scheduler->ready_queue[ assignment ];
     /** Move forward to next status "QUEUED". */
     SetStatus( QUEUED );
-    if ( priority )
-      rt.scheduler->ready_queue[ assignment ].push_front( this );
+    if ( rt.schedule_policy == HMLP_TASK_SCHEDULE_CRITICAL_PATH )
+    {
+      /** Keep the queue in descending order of upward ranks. */
+      auto it = upper_bound( queue.begin(), queue.end(), this, 
+          [] ( Task *a, Task *b ) { return a->upward_rank > b->upward_rank; } );
+      queue.insert( it, this );
+    }
+    else if ( priority && rt.schedule_policy == HMLP_TASK_SCHEDULE_HEFT )
+      queue.push_front( this );
     else
-      rt.scheduler->ready_queue[ assignment ].push_back( this );
+      queue.push_back( this );
 
     /** update the remaining time */
     rt.scheduler->time_remaining[ assignment ] += cost; 
@@ -394,10 +404,22 @@ void Task::Enqueue( size_t tid )
     return;
   };
 
+  /** Assign the task to workers in turn. */
+  if ( rt.schedule_policy == HMLP_TASK_SCHEDULE_FIFO )
+  {
+    size_t next;
+    #pragma omp atomic capture
+    next = rt.scheduler->fifo_next_worker ++;
+    ForceEnqueue( next % rt.n_worker );
+    return;
+  }
+
   /** Determine which worker the task should go to using HEFT policy. */
   for ( int p = 0; p < rt.n_worker; p ++ )
   {
     int i = ( tid + p ) % rt.n_worker;
+    /** Only consider workers on the socket that owns the task's data. */
+    if ( affinity >= 0 && rt.workers[ i ].socket != affinity ) continue;
     float cost = rt.workers[ i ].EstimateCost( this );
     float terminate_t = rt.scheduler->time_remaining[ i ];
     if ( earliest_t == -1.0 || terminate_t + cost < earliest_t )
@@ -407,6 +429,9 @@ void Task::Enqueue( size_t tid )
     }
   }
 
+  /** No active worker on that socket (e.g. after hmlp_set_num_workers). */
+  if ( assignment < 0 ) assignment = tid % rt.n_worker;
+
   /** Dispatch to normal ready queue. */
   ForceEnqueue( assignment );
 
@@ -510,6 +535,137 @@ void MatrixReadWrite::DependencyCleanUp()
 
 
 
+/**
+ *  class CostModel
+ */ 
+
+/** @brief Fold another set of statistics into this one. */ 
+void CostModel::Statistics::Add( const Statistics &other )
+{
+  n  += other.n;
+  x  += other.x;
+  y  += other.y;
+  xx += other.xx;
+  xy += other.xy;
+}; /** end CostModel::Statistics::Add() */
+
+
+/** @brief The size feature is fixed the first time it is requested. */ 
+double CostModel::GetSizeHint( Task *task )
+{
+  if ( task->size_hint < 0.0 ) task->size_hint = max( 0.0, task->SizeHint() );
+  return task->size_hint;
+}; /** end CostModel::GetSizeHint() */
+
+
+/** @brief Add the Event record of an executed task to the worker's statistics. */ 
+void CostModel::Record( Task *task, int tid )
+{
+  double x = GetSizeHint( task );
+  double y = task->event.GetDuration();
+  /** Skip tasks that were not timed. */
+  if ( y <= 0.0 ) return;
+  /** Each worker owns its accumulator; no lock is needed. */
+  auto &acc = pending[ tid ];
+  auto &stat = acc.table[ task->name ];
+  stat.n  += 1.0;
+  stat.x  += x;
+  stat.y  += y;
+  stat.xx += x * x;
+  stat.xy += x * y;
+  if ( task->cost > 0.0 )
+  {
+    acc.total_seconds += y;
+    acc.total_cost += task->cost;
+  }
+}; /** end CostModel::Record() */
+
+
+/** @brief Predict the execution time of a task in seconds. */ 
+float CostModel::Predict( Task *task )
+{
+  double x = GetSizeHint( task );
+  /** Scale Task::cost to seconds with the history (or the default rate). */
+  double seconds_per_cost = default_seconds_per_cost;
+  if ( total_cost > 0.0 ) seconds_per_cost = total_seconds / total_cost;
+  double prediction = task->cost * seconds_per_cost;
+  /** The table is only modified by Merge() between epochs. */
+  auto it = table.find( task->name );
+  if ( it != table.end() && it->second.n >= min_samples )
+  {
+    auto &stat = it->second;
+    /** Use the average if the size is unknown or does not explain the time. */
+    prediction = stat.y / stat.n;
+    double var = stat.n * stat.xx - stat.x * stat.x;
+    if ( x > 0.0 && var > 0.0 )
+    {
+      double b = ( stat.n * stat.xy - stat.x * stat.y ) / var;
+      double a = ( stat.y - b * stat.x ) / stat.n;
+      if ( b > 0.0 && a + b * x > 0.0 ) prediction = a + b * x;
+    }
+  }
+  return prediction;
+}; /** end CostModel::Predict() */
+
+
+/** @brief Merge the records of all workers (called between epochs). */ 
+void CostModel::Merge()
+{
+  for ( auto &acc : pending )
+  {
+    for ( auto &it : acc.table ) table[ it.first ].Add( it.second );
+    total_seconds += acc.total_seconds;
+    total_cost += acc.total_cost;
+    acc = Accumulator();
+  }
+}; /** end CostModel::Merge() */
+
+
+/** @brief Load statistics from a profile (if it exists). */ 
+void CostModel::Load( string filename )
+{
+  FILE *pFile = fopen( filename.data(), "r" );
+  if ( !pFile ) return;
+  char name[ 256 ];
+  Statistics stat;
+  if ( fscanf( pFile, "%lf %lf", &total_seconds, &total_cost ) == 2 )
+  {
+    while ( fscanf( pFile, "%lf %lf %lf %lf %lf %255s", &stat.n, &stat.x, 
+          &stat.y, &stat.xx, &stat.xy, name ) == 6 )
+    {
+      table[ string( name ) ] = stat;
+    }
+  }
+  fclose( pFile );
+}; /** end CostModel::Load() */
+
+
+/** @brief Save statistics to a profile. */ 
+void CostModel::Save( string filename )
+{
+  FILE *pFile = fopen( filename.data(), "w" );
+  if ( !pFile ) 
+  {
+    printf( "CostModel::Save(): cannot open %s\n", filename.data() );
+    return;
+  }
+  fprintf( pFile, "%.17E %.17E\n", total_seconds, total_cost );
+  for ( auto &it : table )
+  {
+    /** Names are stored as single tokens. */
+    if ( it.first.empty() || it.first.find_first_of( " \t\n" ) != string::npos ) 
+      continue;
+    auto &stat = it.second;
+    fprintf( pFile, "%.17E %.17E %.17E %.17E %.17E %s\n", stat.n, stat.x, 
+        stat.y, stat.xx, stat.xy, it.first.data() );
+  }
+  fclose( pFile );
+}; /** end CostModel::Save() */
+
+
+
+
+
 /**
  *  class Scheduler
  */ 
@@ -548,6 +704,16 @@ void Scheduler::Init( int user_n_worker )
   /** Reset normal and nested task counter. */
   n_task_completed = 0;
   n_nested_task_completed = 0;
+  /** Order tasks that are already in ready queues by their upward ranks. */
+  if ( rt.schedule_policy == HMLP_TASK_SCHEDULE_CRITICAL_PATH ) 
+  {
+    ComputeUpwardRanks();
+    for ( int i = 0; i < n_worker; i ++ )
+    {
+      stable_sort( ready_queue[ i ].begin(), ready_queue[ i ].end(), 
+          [] ( Task *a, Task *b ) { return a->upward_rank > b->upward_rank; } );
+    }
+  }
 	/** Reset async distributed consensus variables. */
 	do_terminate = false;
   has_ibarrier = false;
@@ -668,6 +834,10 @@ void Scheduler::Finalize()
 
   /** Reset remaining time. */
   for ( int i = 0; i < n_worker; i ++ ) time_remaining[ i ] = 0.0;
+  /** Restart the round-robin assignment in the next epoch. */
+  fifo_next_worker = 0;
+  /** Fold the per-worker cost records of this epoch into the model. */
+  rt.cost_model.Merge();
   /** Free all normal tasks and reset tasklist. */
   try
   {
@@ -712,6 +882,40 @@ void Scheduler::ReportRemainingTime()
 }; /** end Scheduler::ReportRemainingTime() */
 
 
+/** 
+ *  @brief Compute the upward rank of all tasks in this epoch, i.e. 
+ *         rank( t ) = cost( t ) + max( rank( child ) ) with the estimated
+ *         cost of Worker::EstimateCost(). Tasks are visited
+ *         in reverse topological order starting from exit tasks.
+ */ 
+void Scheduler::ComputeUpwardRanks()
+{
+  unordered_map<Task*, size_t> n_children_remaining;
+  deque<Task*> exits;
+  for ( auto task : tasklist )
+  {
+    task->upward_rank = 0.0;
+    n_children_remaining[ task ] = task->out.size();
+    if ( !task->out.size() ) exits.push_back( task );
+  }
+  while ( exits.size() )
+  {
+    auto *task = exits.front();
+    exits.pop_front();
+    for ( auto child : task->out )
+      task->upward_rank = max( task->upward_rank, child->upward_rank );
+    task->upward_rank += rt.workers[ 0 ].EstimateCost( task );
+    /** A parent is ready once all its children have been ranked. */
+    for ( auto parent : task->in )
+    {
+      auto it = n_children_remaining.find( parent );
+      if ( it != n_children_remaining.end() && -- it->second == 0 ) 
+        exits.push_back( parent );
+    }
+  }
+}; /** end Scheduler::ComputeUpwardRanks() */
+
+
 /** @brief Add an direct edge (dependency) from source to target. */ 
 void Scheduler::DependencyAdd( Task *source, Task *target )
 {
@@ -748,7 +952,7 @@ Task *Scheduler::StealFromQueue( size_t target )
       if ( target_task->stealable )
       {
         ready_queue[ target ].pop_back();
-        time_remaining[ target ] -= target_task->cost;
+        time_remaining[ target ] -= rt.workers[ target ].EstimateCost( target_task );
       }
       else target_task = NULL;
     }
@@ -759,26 +963,37 @@ Task *Scheduler::StealFromQueue( size_t target )
 }; /** end Scheduler::TryStealFromQueue() */
 
 
-/** @brief */
-vector<Task*> Scheduler::StealFromOther()
+/** @brief Steal from workers on my socket first, then from other sockets. */
+vector<Task*> Scheduler::StealFromOther( int tid )
 {
-  int max_remaining_tasks = 0;
   int max_remaining_nested_tasks = 0;
-  int target = 0;
-  /** Decide which target's normal queue to steal. */
-  for ( int p = 0; p < n_worker; p ++ )
+  int target = -1;
+  int my_socket = rt.workers[ tid ].socket;
+  vector<Task*> batch;
+  for ( int is_remote = 0; is_remote < 2; is_remote ++ )
   {
-    if ( ready_queue[ p ].size() > max_remaining_tasks )
+    /** Only compare queues within this pass. */
+    int max_remaining_tasks = 0;
+    target = -1;
+    /** Decide which target's normal queue to steal. */
+    for ( int p = 0; p < n_worker; p ++ )
     {
-      max_remaining_tasks = ready_queue[ p ].size();
-      target = p;
+      if ( ( rt.workers[ p ].socket != my_socket ) != is_remote ) continue;
+      if ( ready_queue[ p ].size() > max_remaining_tasks )
+      {
+        max_remaining_tasks = ready_queue[ p ].size();
+        target = p;
+      }
     }
+    /** Try to steal from target's ready queue.  */
+    if ( target >= 0 ) batch = DispatchFromNormalQueue( target );
+    /** Return if batch is not empty. */
+    if ( batch.size() ) return batch;
+    /** All workers share the same socket. */
+    if ( rt.n_socket == 1 ) break;
   }
-  /** Try to steal from target's ready queue.  */
-  auto batch = DispatchFromNormalQueue( target );
-  /** Return if batch is not empty. */
-  if ( batch.size() ) return batch;
   /** Decide which target's nested queue to steal. */
+  target = -1;
   for ( int p = 0; p < n_worker; p ++ )
   {
     if ( nested_queue[ p ].size() > max_remaining_nested_tasks )
@@ -788,7 +1003,7 @@ vector<Task*> Scheduler::StealFromOther()
     }
   }
   /** Try to steal from target's nested queue.  */
-  batch = DispatchFromNestedQueue( target );
+  if ( target >= 0 ) batch = DispatchFromNestedQueue( target );
   /** Return regardless if batch is empty or not. */
   return batch;
 }; /** end Scheduler::StealFromOther() */
@@ -867,7 +1082,7 @@ vector<Task*> Scheduler::DispatchFromNormalQueue( int tid )
           maximum_batch_size = 1;
           /** If this task cannot be stole, then break. */
           if ( !target_task->stealable ) break;
-          else time_remaining[ tid ] -= target_task->cost;
+          else time_remaining[ tid ] -= rt.workers[ tid ].EstimateCost( target_task );
         }
         /** Dequeue a task and push into this batch. */
         batch.push_back( target_task );
@@ -904,7 +1119,7 @@ bool Scheduler::ConsumeTasks( Worker *me, vector<Task*> &batch )
     {
       ready_queue_lock[ me->tid ].Acquire();
       {
-        time_remaining[ me->tid ] -= task->cost;
+        time_remaining[ me->tid ] -= me->EstimateCost( task );
         if ( time_remaining[ me->tid ] < 0.0 )
           time_remaining[ me->tid ] = 0.0;
       }
@@ -961,7 +1176,7 @@ bool Scheduler::ConsumeTasks( Worker *me, Task *batch, bool is_nested )
       {
         ready_queue_lock[ me->tid ].Acquire();
         {
-          time_remaining[ me->tid ] -= task->cost;
+          time_remaining[ me->tid ] -= me->EstimateCost( task );
           if ( time_remaining[ me->tid ] < 0.0 )
             time_remaining[ me->tid ] = 0.0;
         }
@@ -1006,6 +1221,8 @@ void* Scheduler::EntryPoint( void* arg )
   Worker *me = reinterpret_cast<Worker*>( arg );
   /** Get the callback point of scheduler. */
   Scheduler *scheduler = me->scheduler;
+  /** Stay on the socket that first touches my data. */
+  me->Pin();
   /** This counter measures the idle iteration. */
   size_t idle = 0;
 
@@ -1050,7 +1267,7 @@ void* Scheduler::EntryPoint( void* arg )
     if ( idle > 10 )
     {
       /** Try to steal a (normal or nested) task. */
-      auto stolen_batch = scheduler->StealFromOther();
+      auto stolen_batch = scheduler->StealFromOther( me->tid );
       /** Reset the idle counter if there is executable stolen tasks. */
       if ( scheduler->ConsumeTasks( me, stolen_batch ) ) idle = 0;
     } /** end if ( idle > 10 ) */
@@ -1135,7 +1352,7 @@ void Scheduler::Listen( Worker *me )
     else
     {
       /** Steal a (normal or nested) task from other. */
-      auto stolen_batch = StealFromOther();
+      auto stolen_batch = StealFromOther( me->tid );
       ConsumeTasks( me, stolen_batch );
     }
 
@@ -1208,6 +1425,30 @@ void Scheduler::Summary()
       total_normal_tasks, total_nested_tasks, total_flops, total_mops );
 #endif
 
+  /** Tasks (and mops) executed on each socket; remote ones ran off their affinity. */
+  if ( rt.n_socket > 1 )
+  {
+    vector<size_t> n_tasks( rt.n_socket, 0 ), n_remote_tasks( rt.n_socket, 0 );
+    vector<double> mops( rt.n_socket, 0.0 ), remote_mops( rt.n_socket, 0.0 );
+    for ( auto task : tasklist )
+    {
+      if ( !task->worker ) continue;
+      int socket = task->worker->socket;
+      n_tasks[ socket ] ++;
+      mops[ socket ] += task->event.GetMops();
+      if ( task->affinity >= 0 && task->affinity != socket )
+      {
+        n_remote_tasks[ socket ] ++;
+        remote_mops[ socket ] += task->event.GetMops();
+      }
+    }
+    for ( int i = 0; i < rt.n_socket; i ++ )
+    {
+      printf( "[ RT] socket %2d %5lu [tasks] %5lu [remote] %5.3E mops %5.3E [remote] mops\n", 
+          i, n_tasks[ i ], n_remote_tasks[ i ], mops[ i ], remote_mops[ i ] );
+    }
+  }
+
 
 #ifdef DUMP_ANALYSIS_DATA
   deque<tuple<bool, double, size_t>> timeline;
@@ -1261,11 +1502,85 @@ void Scheduler::Summary()
  */ 
 
 /** @brief */
-RunTime::RunTime() {};
+RunTime::RunTime() 
+{
+  /** (Optional) the scheduling policy can be changed at runtime. */
+  char *str = getenv( "HMLP_SCHEDULE_POLICY" );
+  if ( str )
+  {
+    string policy( str );
+    if ( !policy.compare( "heft" ) ) schedule_policy = HMLP_TASK_SCHEDULE_HEFT;
+    if ( !policy.compare( "cp"   ) ) schedule_policy = HMLP_TASK_SCHEDULE_CRITICAL_PATH;
+    if ( !policy.compare( "fifo" ) ) schedule_policy = HMLP_TASK_SCHEDULE_FIFO;
+  }
+  /** (Optional) calibrate the cost model with previous runs. */
+  str = getenv( "HMLP_COST_PROFILE" );
+  if ( str )
+  {
+    cost_profile = string( str );
+    cost_model.Load( cost_profile );
+  }
+};
 
 /** @brief */
 RunTime::~RunTime() {};
 
+
+/** 
+ *  @brief Read the cpus of each NUMA node from sysfs and split workers
+ *         into contiguous blocks, one block per node. Worker i is mapped
+ *         to the ( i % n )-th cpu of its node. Without sysfs (or with a 
+ *         single node) all workers belong to socket 0 and nothing changes.
+ *         Workers are only pinned (Worker::cpu >= 0) with HMLP_USE_NUMA.
+ */ 
+void RunTime::DetectTopology()
+{
+  vector<vector<int>> node_cpus;
+#ifdef __linux__
+  for ( int node = 0; node < MAX_WORKER; node ++ )
+  {
+    string filename = string( "/sys/devices/system/node/node" ) 
+      + to_string( node ) + string( "/cpulist" );
+    FILE *file = fopen( filename.data(), "r" );
+    if ( !file ) break;
+    /** Parse the cpulist, e.g. "0-13,28-41". */
+    vector<int> cpus;
+    int beg, end;
+    while ( fscanf( file, "%d", &beg ) == 1 )
+    {
+      end = beg;
+      int c = fgetc( file );
+      if ( c == '-' )
+      {
+        if ( fscanf( file, "%d", &end ) != 1 ) break;
+        c = fgetc( file );
+      }
+      for ( int cpu = beg; cpu <= end; cpu ++ ) cpus.push_back( cpu );
+      if ( c != ',' ) break;
+    }
+    fclose( file );
+    /** Skip memory-only nodes. */
+    if ( cpus.size() ) node_cpus.push_back( cpus );
+  }
+#endif
+  /** Each socket must host at least one worker. */
+  n_socket = std::max( (size_t)1, std::min( node_cpus.size(), (size_t)n_worker ) );
+  for ( int i = 0; i < n_worker; i ++ )
+  {
+    int socket = ( i * n_socket ) / n_worker;
+    int rank = i - ( socket * n_worker + n_socket - 1 ) / n_socket;
+    workers[ i ].socket = socket;
+    workers[ i ].cpu = -1;
+#ifdef HMLP_USE_NUMA
+    if ( node_cpus.size() ) 
+    {
+      auto &cpus = node_cpus[ socket ];
+      workers[ i ].cpu = cpus[ rank % cpus.size() ];
+    }
+#endif
+  }
+}; /** end RunTime::DetectTopology() */
+
 /** @brief */
 void RunTime::Init( mpi::Comm comm = MPI_COMM_WORLD )
 {
@@ -1275,6 +1590,8 @@ void RunTime::Init( mpi::Comm comm = MPI_COMM_WORLD )
     {
       n_worker = omp_get_max_threads();
       n_max_worker = n_worker;
+      /** Assign workers to sockets (and cpus if HMLP_USE_NUMA). */
+      DetectTopology();
       /** Check whether MPI has been initialized? */
       int is_mpi_init = false;
       mpi::Initialized( &is_mpi_init );
@@ -1315,6 +1632,8 @@ void RunTime::Init( int* argc, char*** argv, mpi::Comm comm = MPI_COMM_WORLD )
       /** Acquire the number of (maximum) workers from OpenMP. */
       n_worker = omp_get_max_threads();
       n_max_worker = n_worker;
+      /** Assign workers to sockets (and cpus if HMLP_USE_NUMA). */
+      DetectTopology();
       /** Check whether MPI has been initialized? */
       int is_mpi_init = false;
       mpi::Initialized( &is_mpi_init );
@@ -1378,6 +1697,9 @@ void RunTime::Finalize()
     {
       /** Finalize the scheduler and delete it. */
       scheduler->Finalize();
+      /** Only one process writes the profile. */
+      if ( cost_profile.size() && !scheduler->GetCommRank() ) 
+        cost_model.Save( cost_profile );
       delete scheduler;
       /** Set the initialized flag to false. */
       is_init = false;
@@ -1464,6 +1786,15 @@ void hmlp_init( int *argc, char ***argv, mpi::Comm comm )
 /** @brief */
 void hmlp_set_num_workers( int n_worker ) { hmlp::rt.n_worker = n_worker; };
 
+/** @brief */
+int hmlp_get_num_socket() { return hmlp::rt.n_socket; };
+
+/** @brief */
+void hmlp_set_schedule_policy( hmlp::TaskSchedulePolicy policy ) 
+{ 
+  hmlp::rt.schedule_policy = policy; 
+};
+
 
 
 void hmlp_run() { hmlp::rt.Run(); };
@@ -72,6 +72,22 @@ namespace hmlp
 //  HMLP_SCHEDULE_HEFT
 //} SchedulePolicy;
 
+/** 
+ *  @brief Policies for assigning ready tasks to workers.
+ *
+ *  HMLP_TASK_SCHEDULE_HEFT:          earliest finish time; priority tasks 
+ *                                    are pushed to the front of the queue.
+ *  HMLP_TASK_SCHEDULE_CRITICAL_PATH: earliest finish time; ready queues are
+ *                                    ordered by the upward rank of tasks.
+ *  HMLP_TASK_SCHEDULE_FIFO:          round-robin without priority.
+ */
+typedef enum 
+{
+  HMLP_TASK_SCHEDULE_HEFT,
+  HMLP_TASK_SCHEDULE_CRITICAL_PATH,
+  HMLP_TASK_SCHEDULE_FIFO
+} TaskSchedulePolicy;
+
 /** @brief */
 typedef enum { ALLOCATED, NOTREADY, QUEUED, RUNNING, EXECUTED, DONE, CANCELLED } TaskStatus;
 
@@ -192,6 +208,18 @@ class Task
 
     bool priority = false;
 
+    /** Longest cost-weighted path from this task to the exit of the DAG. */
+    float upward_rank = 0;
+
+    /** Calibrated cost given by Worker::EstimateCost() (negative if unset). */
+    float estimated_cost = -1;
+
+    /** SizeHint() captured before execution (negative if unset). */
+    double size_hint = -1;
+
+    /** The socket whose workers should execute this task (-1 for any). */
+    int affinity = -1;
+
     Event event;
 
     TaskStatus GetStatus();
@@ -220,6 +248,9 @@ class Task
 
     virtual void GetEventRecord();
 
+    /** Size feature (flops + mops) of the cost model before execution. */
+    virtual double SizeHint();
+
     virtual void DependencyAnalysis();
 
     /* function ptr */
@@ -273,6 +304,74 @@ void hmlp_msg_dependency_analysis(
 
 
 
+/**
+ *  class CostModel
+ */ 
+
+/** 
+ *  @brief Online cost model fitted from the Event records of executed
+ *         tasks. For each task name, seconds = a + b * Task::SizeHint()
+ *         is fitted by least squares. Tasks without enough records use
+ *         Task::cost scaled by the average seconds per unit of cost, so
+ *         all predictions are in seconds. Records are accumulated per 
+ *         worker and merged at the end of each epoch. The sufficient 
+ *         statistics can be persisted in a profile file.
+ */ 
+class CostModel
+{
+  public:
+
+    void Record( Task *task, int tid );
+
+    float Predict( Task *task );
+
+    void Merge();
+
+    void Load( string filename );
+
+    void Save( string filename );
+
+    /** Capture Task::SizeHint() once (before execution). */
+    static double GetSizeHint( Task *task );
+
+  private:
+
+    /** Sufficient statistics of the linear least squares. */
+    struct Statistics 
+    { 
+      double n = 0, x = 0, y = 0, xx = 0, xy = 0; 
+      void Add( const Statistics &other );
+    };
+
+    /** Per-worker records of the current epoch. */
+    struct Accumulator
+    {
+      map<string, Statistics> table;
+      double total_seconds = 0.0;
+      double total_cost = 0.0;
+    };
+
+    /** Statistics for each task name (read-only during an epoch). */
+    map<string, Statistics> table;
+
+    /** Seconds and Task::cost accumulated over all records. */
+    double total_seconds = 0.0;
+    double total_cost = 0.0;
+
+    /** Records of each worker, merged by Merge(). */
+    Accumulator pending[ MAX_WORKER ];
+
+    /** Minimum number of records before the fitted model is used. */
+    size_t min_samples = 8;
+
+    /** Seconds per unit of Task::cost before any record (1 GFLOP at 10 GFLOPS). */
+    double default_seconds_per_cost = 1E-1;
+
+}; /** end class CostModel */
+
+
+
+
 /** @brief This is a specific type of task that represents NOP. */
 template<typename ARGUMENT>
 class NULLTask : public Task
@@ -442,6 +541,15 @@ class RecvTask : public ListenerTask
 
 
 
+/** 
+ *  @brief Socket affinity of tasks created on arg (-1 for any socket).
+ *         Argument types that own data, e.g. tree::Node, overload this
+ *         such that their tasks stay on the socket that touches them.
+ */ 
+template<typename ARG>
+int TaskAffinity( ARG *arg ) { return -1; };
+
+
 /** @brief Recursive task sibmission (base case). */ 
 template<typename ARG>
 void RecuTaskSubmit( ARG *arg ) { /** do nothing */ }; 
@@ -458,6 +566,7 @@ void RecuTaskSubmit( ARG *arg, TASK& dummy, Args&... dummyargs )
     auto task = new TASK();
     task->Submit();
     task->Set( arg );
+    task->affinity = TaskAffinity( arg );
     task->DependencyAnalysis();
   }
   /** now recurs to Args&... args, types are deduced automatically */
@@ -599,6 +708,9 @@ class Scheduler : public mpi::MPIObject
 
     float time_remaining[ MAX_WORKER ];
 
+    /** The next worker to receive a task (HMLP_TASK_SCHEDULE_FIFO). */
+    size_t fifo_next_worker = 0;
+
     void ReportRemainingTime();
 
     /** Manually describe the dependencies */
@@ -614,6 +726,8 @@ class Scheduler : public mpi::MPIObject
 
     void ExecuteNestedTasksWhileWaiting( Worker *me, Task *waiting_task );
 
+    void ComputeUpwardRanks();
+
     void Summary();
 
 
@@ -642,7 +756,7 @@ class Scheduler : public mpi::MPIObject
 
     vector<Task*> DispatchFromNestedQueue( int tid );
 
-    vector<Task*> StealFromOther();
+    vector<Task*> StealFromOther( int tid );
 
     Task *StealFromQueue( size_t target );
 
@@ -731,6 +845,18 @@ class RunTime
 
     Scheduler *scheduler;
 
+    /** (Default) use HEFT or read HMLP_SCHEDULE_POLICY=heft|cp|fifo. */
+    TaskSchedulePolicy schedule_policy = HMLP_TASK_SCHEDULE_HEFT;
+
+    /** Task costs calibrated on this machine. */
+    CostModel cost_model;
+
+    /** (Optional) HMLP_COST_PROFILE=filename loads and saves cost_model. */
+    string cost_profile;
+
+    /** Number of sockets (NUMA nodes) that host workers. */
+    int n_socket = 1;
+
   private:
   
     /** Argument count. */
@@ -745,6 +871,8 @@ class RunTime
     bool is_in_epoch_session = false;
     /** Print progress with prefix information. */
     void Print( string msg );
+    /** Map workers to sockets and pick their cpus (compact per socket). */
+    void DetectTopology();
     /** Print error message and exit with error. */
     void ExitWithError( string msg );
 
@@ -758,6 +886,10 @@ hmlp::Device *hmlp_get_device( int i );
 
 bool hmlp_is_in_epoch_session();
 
+void hmlp_set_schedule_policy( hmlp::TaskSchedulePolicy policy );
+
+int hmlp_get_num_socket();
+
 //bool hmlp_is_nested_queue_empty();
 
 //void hmlp_set_num_background_worker( int n_background_worker );
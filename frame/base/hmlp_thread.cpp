@@ -19,6 +19,10 @@
  **/  
 
 
+#ifdef __linux__
+#include <sched.h>
+#endif
+
 #include <hmlp_runtime.hpp>
 #include <hmlp_thread.hpp>
 
@@ -600,6 +604,8 @@ bool Worker::Execute( Task *batch )
     if ( task->GetStatus() == RUNNING )
     {
       task->worker = this;
+      /** Fix the size feature of the cost model before execution. */
+      CostModel::GetSizeHint( task );
       task->event.Begin( this->tid );
       task->Execute( this );
     }
@@ -615,6 +621,8 @@ bool Worker::Execute( Task *batch )
   {
     task->event.Terminate();
     task->GetEventRecord();
+    /** Calibrate the cost model with the new record. */
+    hmlp_get_runtime_handle()->cost_model.Record( task, tid );
     /** Move to the next task in the batch */
     task = task->next;
   }
@@ -633,7 +641,29 @@ bool Worker::Execute( Task *batch )
  */ 
 void Worker::WaitExecute() { if ( device ) device->waitexecute(); };
 
-float Worker::EstimateCost( class Task *task ) { return task->cost; };
+/** @brief Estimate (only once) the cost of a task with the cost model. */ 
+float Worker::EstimateCost( class Task *task ) 
+{ 
+  if ( task->estimated_cost < 0.0 ) 
+    task->estimated_cost = hmlp_get_runtime_handle()->cost_model.Predict( task );
+  return task->estimated_cost; 
+};
+
+
+/** @brief Bind the calling thread to its logical cpu (Linux only). */
+void Worker::Pin()
+{
+  if ( cpu < 0 ) return;
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO( &cpuset );
+  CPU_SET( cpu, &cpuset );
+  if ( sched_setaffinity( 0, sizeof( cpu_set_t ), &cpuset ) )
+  {
+    printf( "Worker::Pin(): fail to pin worker %d to cpu %d\n", tid, cpu );
+  }
+#endif
+}; /** end Worker::Pin() */
 
 
 
@@ -291,8 +291,17 @@ class Worker
 
     float EstimateCost( class Task* task );
 
+    /** Bind the calling thread to cpu (no-op if cpu < 0). */
+    void Pin();
+
     class Scheduler *scheduler;
 
+    /** The socket (NUMA node) this worker belongs to. */
+    int socket = 0;
+
+    /** The logical cpu this worker is pinned to (-1 if not pinned). */
+    int cpu = -1;
+
 #ifdef USE_PTHREAD_RUNTIME
     pthread_t pthreadid;
 #endif
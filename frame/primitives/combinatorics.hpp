@@ -386,10 +386,10 @@ T Select( size_t k, std::vector<T> &x, hmlp::mpi::Comm comm )
 
 
 template<typename T>
-vector<vector<size_t>> MedianThreeWaySplit( vector<T> &v, T tol )
+vector<vector<size_t>> MedianThreeWaySplit( vector<T> &v, T tol, T &median )
 {
   size_t n = v.size();
-  auto median = Select( n, n / 2, v );
+  median = Select( n, n / 2, v );
   /** Split indices of v into 3-way: lhs, rhs, and mid. */
   vector<vector<size_t>> three_ways( 3 );
   auto & lhs = three_ways[ 0 ];
@@ -405,12 +405,24 @@ vector<vector<size_t>> MedianThreeWaySplit( vector<T> &v, T tol )
 }; /** end MedianTreeWaySplit() */
 
 
+template<typename T>
+vector<vector<size_t>> MedianThreeWaySplit( vector<T> &v, T tol )
+{
+  T median;
+  return MedianThreeWaySplit( v, tol, median );
+}; /** end MedianTreeWaySplit() */
 
-/** @brief Split values into two halfs accroding to the median. */ 
+
+
+/** 
+ *  @brief Split values into two halfs accroding to the median. 
+ *         The median is also returned such that new values can
+ *         later be routed with the same decision.
+ */ 
 template<typename T>
-vector<vector<size_t>> MedianSplit( vector<T> &v )
+vector<vector<size_t>> MedianSplit( vector<T> &v, T &median )
 {
-  auto three_ways = MedianThreeWaySplit( v, (T)1E-6 );
+  auto three_ways = MedianThreeWaySplit( v, (T)1E-6, median );
   vector<vector<size_t>> two_ways( 2 );
   two_ways[ 0 ] = three_ways[ 0 ];
   two_ways[ 1 ] = three_ways[ 1 ];  
@@ -426,6 +438,15 @@ vector<vector<size_t>> MedianSplit( vector<T> &v )
 }; /** end MedianSplit() */
 
 
+/** @brief Split values into two halfs accroding to the median. */ 
+template<typename T>
+vector<vector<size_t>> MedianSplit( vector<T> &v )
+{
+  T median;
+  return MedianSplit( v, median );
+}; /** end MedianSplit() */
+
+
 
 
 
@@ -40,20 +40,35 @@ namespace cnn
 {
 
 /**
- *
+ *  @brief Offset of C( i, j ), where i is the output channel and j is the 
+ *         window of the whole batch (nxy windows per image).
+ */ 
+template<bool NCHW>
+inline size_t conv2d_offset( int i, size_t j, int m, size_t nxy )
+{
+  if ( NCHW ) return ( j / nxy ) * nxy * m + i * nxy + j % nxy;
+  else        return j * m + i;
+}; /** end conv2d_offset() */
+
+
+/**
+ *  @brief Semiring rank-k update of a MC-by-NC block. Columns of C are
+ *         windows of the whole batch; C( i, j ) is stored at 
+ *         conv2d_offset<NCHW>( i, j, ldc, nxy ).
  */ 
 template<
   int KC, int MR, int NR, int PACK_MR, int PACK_NR,
+  bool NCHW,
   typename SEMIRINGKERNEL,
   typename TA, typename TB, typename TC, typename TV>
 void rank_k_macro_kernel
 (
   Worker &thread,
-  int ic, int jc, int pc,
+  int ic, size_t jc, int pc,
   int  m, int n,  int  k,
   TA *packA,
   TB *packB,
-  TV *C, int ldc,
+  TV *C, int ldc, size_t nxy,
   SEMIRINGKERNEL semiringkernel
 )
 {
@@ -64,6 +79,10 @@ void rank_k_macro_kernel
   auto loop2nd = GetRange( 0, m,      MR );
   auto pack2nd = GetRange( 0, m, PACK_MR );
 
+  /** NHWC outputs are column-major; NCHW outputs are row-major per image. */
+  int rs_c = NCHW ? nxy : 1;
+  int cs_c = NCHW ? 1 : ldc;
+
   for ( int j   = loop3rd.beg(), jp  = pack3rd.beg(); 
             j   < loop3rd.end();
             j  += loop3rd.inc(), jp += pack3rd.inc() )     // beg 3rd loop
@@ -74,6 +93,9 @@ void rank_k_macro_kernel
     aux.do_packC = 0;
     aux.jb       = std::min( n - j, NR );
 
+    /** An NCHW tile is strided only if it does not cross two images. */
+    bool is_strided = !NCHW || ( jc + j ) / nxy == ( jc + j + NR - 1 ) / nxy;
+
     for ( int i  = loop2nd.beg(), ip  = pack2nd.beg(); 
               i  < loop2nd.end(); 
               i += loop2nd.inc(), ip += pack2nd.inc() )    // beg 2nd loop
@@ -84,20 +106,19 @@ void rank_k_macro_kernel
         aux.b_next += ic_comm.GetNumThreads() * PACK_NR * k;
       }
       
-      if ( aux.jb == NR && aux.ib == MR )                 
+      if ( aux.jb == NR && aux.ib == MR && is_strided )                 
       {
         semiringkernel
         (
           k,
           &packA[ ip * k ],
           &packB[ jp * k ],
-          &C[ j * ldc + i ], 1, ldc,
+          &C[ conv2d_offset<NCHW>( ic + i, jc + j, ldc, nxy ) ], rs_c, cs_c,
           &aux
         );
       }
       else                                                 // corner case
       {
-        // TODO: this should be initC.
         TV ctmp[ MR * NR ] = { (TV)0.0 };
         semiringkernel
         (
@@ -107,50 +128,39 @@ void rank_k_macro_kernel
           ctmp, 1, MR,
           &aux
         );
-        if ( pc )
-        {
-          for ( auto jj = 0; jj < aux.jb; jj ++ )
-          {
-            for ( auto ii = 0; ii < aux.ib; ii ++ )
-            {
-              C[ ( j + jj ) * ldc + i + ii ] += ctmp[ jj * MR + ii ];
-            }
-          }
-        }
-        else 
+        for ( auto jj = 0; jj < aux.jb; jj ++ )
         {
-          for ( auto jj = 0; jj < aux.jb; jj ++ )
+          for ( auto ii = 0; ii < aux.ib; ii ++ )
           {
-            for ( auto ii = 0; ii < aux.ib; ii ++ )
-            {
-              C[ ( j + jj ) * ldc + i + ii ] = ctmp[ jj * MR + ii ];
-            }
+            auto &cij = C[ conv2d_offset<NCHW>( ic + i + ii, jc + j + jj, ldc, nxy ) ];
+            if ( pc ) cij += ctmp[ jj * MR + ii ];
+            else      cij  = ctmp[ jj * MR + ii ];
           }
         }
       }
     }                                                      // end 2nd loop
   }                                                        // end 3rd loop
-}                                                          // end rank_k_macro_kernel
+}; /** end rank_k_macro_kernel() */
+
 
 /**
- *
+ *  @brief The last rank-k update of a MC-by-NC block. Columns of C are
+ *         windows of the whole batch; C( i, j ) is stored at 
+ *         conv2d_offset<NCHW>( i, j, ldc, nxy ).
  */ 
 template<
-  int KC, 
-  int MR, 
-  int NR, 
-  int PACK_MR, 
-  int PACK_NR,
+  int KC, int MR, int NR, int PACK_MR, int PACK_NR,
+  bool NCHW,
   typename MICROKERNEL,
   typename TA, typename TB, typename TC, typename TV>
 void fused_macro_kernel
 (
   Worker &thread,
-  int ic, int jc, int pc,
-  int  m,  int n,  int k,
+  int ic, size_t jc, int pc,
+  int  m, int n,  int  k,
   TA *packA,
   TB *packB,
-  TV *C, int ldc,
+  TV *C, int ldc, size_t nxy,
   MICROKERNEL microkernel
 )
 {
@@ -161,6 +171,10 @@ void fused_macro_kernel
   auto loop2nd = GetRange( 0, m,      MR );
   auto pack2nd = GetRange( 0, m, PACK_MR );
 
+  /** NHWC outputs are column-major; NCHW outputs are row-major per image. */
+  int rs_c = NCHW ? nxy : 1;
+  int cs_c = NCHW ? 1 : ldc;
+
   for ( int j   = loop3rd.beg(), jp  = pack3rd.beg(); 
             j   < loop3rd.end();
             j  += loop3rd.inc(), jp += pack3rd.inc() )     // beg 3rd loop
@@ -171,6 +185,9 @@ void fused_macro_kernel
     aux.do_packC = 0;
     aux.jb       = std::min( n - j, NR );
 
+    /** An NCHW tile is strided only if it does not cross two images. */
+    bool is_strided = !NCHW || ( jc + j ) / nxy == ( jc + j + NR - 1 ) / nxy;
+
     for ( int i  = loop2nd.beg(), ip  = pack2nd.beg(); 
               i  < loop2nd.end(); 
               i += loop2nd.inc(), ip += pack2nd.inc() )    // beg 2nd loop
@@ -180,15 +197,15 @@ void fused_macro_kernel
       {
         aux.b_next += ic_comm.GetNumThreads() * PACK_NR * k;
       }
-
-      if ( aux.jb == NR && aux.ib == MR )                 
+      
+      if ( aux.jb == NR && aux.ib == MR && is_strided )                 
       {
         microkernel
         (
           k,
           &packA[ ip * k ],
           &packB[ jp * k ],
-          &C[ j * ldc + i ], 1, ldc,
+          &C[ conv2d_offset<NCHW>( ic + i, jc + j, ldc, nxy ) ], rs_c, cs_c,
           &aux
         );
       }
@@ -203,47 +220,38 @@ void fused_macro_kernel
           ctmp, 1, MR,
           &aux
         );
-
-        if ( pc )
-        {
-          for ( auto jj = 0; jj < aux.jb; jj ++ )
-          {
-            for ( auto ii = 0; ii < aux.ib; ii ++ )
-            {
-              C[ ( j + jj ) * ldc + i + ii ] += ctmp[ jj * MR + ii ];
-            }
-          }
-        }
-        else 
+        for ( auto jj = 0; jj < aux.jb; jj ++ )
         {
-          for ( auto jj = 0; jj < aux.jb; jj ++ )
+          for ( auto ii = 0; ii < aux.ib; ii ++ )
           {
-            for ( auto ii = 0; ii < aux.ib; ii ++ )
-            {
-              C[ ( j + jj ) * ldc + i + ii ] = ctmp[ jj * MR + ii ];
-            }
+            auto &cij = C[ conv2d_offset<NCHW>( ic + i + ii, jc + j + jj, ldc, nxy ) ];
+            if ( pc ) cij += ctmp[ jj * MR + ii ];
+            else      cij  = ctmp[ jj * MR + ii ];
           }
         }
       }
     }                                                      // end 2nd loop
   }                                                        // end 3rd loop
-};                                                         // end fused_macro_kernel
+}; /** end fused_macro_kernel() */
 
 
 
-/*
- *
+/**
+ *  @brief Convolve a batch of images as one GEMM of size d1-by-( batchSize 
+ *         * nx * ny ) with k = w1 * h1 * d0. Windows are gathered into 
+ *         packB inside the 5th loop (no unfolded image is ever formed), so
+ *         the workspace is independent of the batch size.
  */ 
 template<
   int MC, int NC, int KC, int MR, int NR, 
   int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
-  bool USE_STRASSEN,
+  bool USE_STRASSEN, bool NCHW,
   typename SEMIRINGKERNEL, typename MICROKERNEL,
   typename TA, typename TB, typename TC, typename TV>
 void conv2d_internal
 (
   Worker &thread,
-  int w0, int h0, int d0, int s, int p,
+  int w0, int h0, int d0, int s, int p, int batchSize,
   TB *B, 
   int w1, int h1, int d1,
   TA *A,
@@ -259,35 +267,27 @@ void conv2d_internal
           + ( thread.ic_id                               ) * PACK_MC * KC;
   packB  += ( thread.jc_id                               ) * pack_nc * KC;
 
-
-  // Now compute parameters such that I can transform the problem into GEMM.
+  /** Transform the problem into GEMM. */
   int m = d1;
   int nx = ( w0 - w1 + 2 * p ) / s + 1;
   int ny = ( h0 - h1 + 2 * p ) / s + 1;
-  int n = nx * ny;
+  size_t nxy = (size_t)nx * ny;
+  size_t n = nxy * batchSize;
   int k = w1 * h1 * d0;
 
-  //auto loop6th = GetRange( HMLP_SCHEDULE_HEFT, 0, n, nc, thread.jc_id, thread.jc_nt );
   auto loop6th = GetRange( 0, n, nc, thread.jc_id, thread.jc_nt );
   auto loop5th = GetRange( 0, k, KC );
   auto loop4th = GetRange( 0, m, MC, thread.ic_id, thread.ic_nt );
 
-  //printf( "tid %d beg %d end %d inc %d\n", thread.jc_id, loop6th.beg(), loop6th.end(), loop6th.inc() );
-
-  //double my_beg = omp_get_wtime();
-  /*
-   *  @CHENHAN: loop over your filters.
-   */ 
-  for ( int jc  = loop6th.beg(); 
-            jc  < loop6th.end(); 
-            jc += loop6th.inc() )                          // beg 6th loop 
+  /** Loop over NC windows of the batch. */
+  for ( size_t jc  = loop6th.beg(); 
+               jc  < loop6th.end(); 
+               jc += loop6th.inc() )                       // beg 6th loop 
   {
     auto &jc_comm = *thread.jc_comm;
-    auto jb = std::min( n - jc, nc );
+    int jb = std::min( n - jc, (size_t)nc );
 
-    /*
-     *  @CHENHAN: loop over your window size ( w1 * h1 * d0 ).
-     */ 
+    /** Loop over KC elements of a window ( w1 * h1 * d0 ). */
     for ( int pc  = loop5th.beg();
               pc  < loop5th.end();
               pc += loop5th.inc() )
@@ -296,9 +296,7 @@ void conv2d_internal
       auto pb = std::min( k - pc, KC );
       auto is_the_last_pc_iteration = ( pc + KC >= k );
 
-      /*
-       *  @CHENHAN: pack image into packB.
-       */ 
+      /** Gather windows straight into the micro-panels of packB. */
       auto looppkB = GetRange( 0, jb,      NR, thread.ic_jr, pc_comm.GetNumThreads() ); 
       auto packpkB = GetRange( 0, jb, PACK_NR, thread.ic_jr, pc_comm.GetNumThreads() ); 
 
@@ -306,18 +304,11 @@ void conv2d_internal
                 j   < looppkB.end(); 
                 j  += looppkB.inc(), jp += packpkB.inc() ) 
       {
-        auto x0 = ( ( jc + j ) % nx ) * s - p; // top-left
-        auto y0 = ( ( jc + j ) / nx ) * s - p; // top-left
-
-#ifdef DEBUG_CONV2D
-     printf( "x0 %4d y0 %4d\n", x0, y0 );
-#endif
-
-        pack2Dimg<PACK_NR>                            // packB
+        pack2Dpatch<PACK_NR, NCHW>                         // packB
         (
           std::min( jb - j, NR ), pb, 
           &packB[ jp  * pb ], 
-          x0, y0, pc,
+          jc + j, pc,
           B,
           w0, h0, d0, s, p,
           w1, h1 
@@ -325,7 +316,6 @@ void conv2d_internal
       }
       pc_comm.Barrier();
 
-
 #ifdef DEBUG_CONV2D
       for ( int i = 0; i < pb; i ++ )
       {
@@ -342,7 +332,6 @@ void conv2d_internal
       printf( "\n" );
 #endif
 
-
       for ( int ic  = loop4th.beg(); 
                 ic  < loop4th.end(); 
                 ic += loop4th.inc() )                      // beg 4th loop
@@ -353,9 +342,7 @@ void conv2d_internal
         auto looppkA = GetRange( 0, ib,      MR, thread.jr_id, thread.jr_nt ); 
         auto packpkA = GetRange( 0, ib, PACK_MR, thread.jr_id, thread.jr_nt ); 
 
-        /*
-         *  @CHENHAN: assume filters were already packed format.
-         */  
+        /** Filters are d1-by-k (row-major). */
         for ( int i   = looppkA.beg(), ip  = packpkA.beg();  
                   i   < looppkA.end(); 
                   i  += looppkA.inc(), ip += packpkA.inc() )     
@@ -370,28 +357,28 @@ void conv2d_internal
         if ( is_the_last_pc_iteration )                    // fused_macro_kernel
         {
           fused_macro_kernel
-          <KC, MR, NR, PACK_MR, PACK_NR, MICROKERNEL, TA, TB, TC, TV>
+          <KC, MR, NR, PACK_MR, PACK_NR, NCHW, MICROKERNEL, TA, TB, TC, TV>
           (
             thread, 
             ic, jc, pc,
             ib, jb, pb,
             packA, 
             packB, 
-            C + jc * m + ic, m, 
+            C, m, nxy,
             microkernel
           );
         }
         else                                               // semiring rank-k update
         {
           rank_k_macro_kernel
-          <KC, MR, NR, PACK_MR, PACK_NR, SEMIRINGKERNEL, TA, TB, TC, TV>
+          <KC, MR, NR, PACK_MR, PACK_NR, NCHW, SEMIRINGKERNEL, TA, TB, TC, TV>
           (  
             thread, 
             ic, jc, pc,
             ib, jb, pb,
             packA,
             packB,
-            C + jc * m + ic, m, 
+            C, m, nxy,
             semiringkernel
           );
         }
@@ -400,11 +387,7 @@ void conv2d_internal
       pc_comm.Barrier();
     }                                                      // end 5th loop
   }                                                        // end 6th loop
-  //double my_time = omp_get_wtime() - my_beg;
-  //double my_flop = ( ( loop6th.end() - loop6th.beg() ) / 1e+9 ) * 2 * m * k;
-  ////printf( "tid %d GFLOPS %5.2lf\n", thread.jc_id, my_flop / my_time );
-  //printf( "tid %d GFLOPS %5.2lf\n", thread.jc_id, my_time );
-};                                                         // end cnn_internal
+};                                                         // end conv2d_internal
 
 
 
@@ -455,34 +438,30 @@ template<
   typename TA, typename TB, typename TC, typename TV>
 void conv2d
 (
-  int w0, int h0, int d0, int s, int p,
+  int w0, int h0, int d0, int s, int p, int batchSize,
   TA *B,
   int w1, int h1, int d1,
   TB *A,
   TC *C,
   SEMIRINGKERNEL semiringkernel, 
-  MICROKERNEL microkernel         
+  MICROKERNEL microkernel,
+  hmlpLayout_t layout = HMLP_NHWC
 )
 {
   int jc_nt = 1, pc_nt = 1, ic_nt = 1, jr_nt = 1;
   int nc = NC, pack_nc = PACK_NC;
-  char *str;
 
-  int m = d1;
   int nx = ( w0 - w1 + 2 * p ) / s + 1;
   int ny = ( h0 - h1 + 2 * p ) / s + 1;
-  int n = nx * ny;
-  int k = w1 * h1 * d0;
-
-
-  //printf( "m %4d n %4d k %4d\n", m, n, k );
+  size_t n = (size_t)nx * ny * batchSize;
 
   TA *packA_buff = NULL;
   TB *packB_buff = NULL;
 
-  // Early return if possible
+  /** Early return if possible. */
+  if ( !n || !d1 ) return;
 
-  // Check the environment variable.
+  /** Check the environment variable. */
   if ( omp_get_num_threads() == 1 && omp_get_max_threads() > 1 )
   {
     jc_nt = hmlp_read_nway_from_env( "KS_JC_NT" );
@@ -490,112 +469,80 @@ void conv2d
     jr_nt = hmlp_read_nway_from_env( "KS_JR_NT" );
   }
 
-
   if ( jc_nt > 1 )
   {
     nc = ( ( n - 1 ) / ( NR * jc_nt ) + 1 ) * NR;
-    //if ( nc > NC ) nc = NC;
+    if ( nc > NC ) nc = NC;
     pack_nc = ( nc / NR ) * PACK_NR;
   }
 
-  // allocate packing memory
+  /** Allocate packing memory (independent of the batch size). */
   packA_buff  = hmlp_malloc<ALIGN_SIZE, TA>( KC, ( PACK_MC + 1 ) * jc_nt * ic_nt,         sizeof(TA) );
   packB_buff  = hmlp_malloc<ALIGN_SIZE, TB>( KC, ( pack_nc + 1 ) * jc_nt,                 sizeof(TB) ); 
 
-  //#pragma omp parallel for
-  //for ( int i = 0; i < KC * ( PACK_MC + 1 ) * jc_nt * ic_nt; i ++ ) packA_buff[ i ] = 1.0;
-
-
-  // allocate tree communicator
+  /** Allocate tree communicator. */
   thread_communicator my_comm( jc_nt, pc_nt, ic_nt, jr_nt );
 
+  if ( USE_STRASSEN )
+  {
+    printf( "cnn: strassen algorithms haven't been implemented." );
+    exit( 1 );
+  }
 
   #pragma omp parallel num_threads( my_comm.GetNumThreads() ) 
   {
     Worker thread( &my_comm );
 
-    if ( USE_STRASSEN )
+    if ( layout == HMLP_NCHW )
     {
-      printf( "cnn: strassen algorithms haven't been implemented." );
-      exit( 1 );
+      conv2d_internal
+      <MC, NC, KC, MR, NR, 
+      PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+      USE_STRASSEN, true,
+      SEMIRINGKERNEL, MICROKERNEL,
+      TA, TB, TC, TV>
+      (
+        thread,
+        w0, h0, d0, s, p, batchSize,
+        B,
+        w1, h1, d1,
+        A,
+        C,
+        semiringkernel, microkernel,
+        nc, pack_nc,
+        packA_buff,
+        packB_buff
+      );
     }
-
-    conv2d_internal
-    <MC, NC, KC, MR, NR, 
-    PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
-    USE_STRASSEN,
-    SEMIRINGKERNEL, MICROKERNEL,
-    TA, TB, TC, TB>
-    (
-      thread,
-      w0, h0, d0, s, p,
-      B,
-      w1, h1, d1,
-      A,
-      C,
-      semiringkernel, microkernel,
-      nc, pack_nc,
-      packA_buff,
-      packB_buff
-    );
-  }                                                        // end omp 
-
-#ifdef DEBUG_CONV2D
-  for ( int j = 0; j < ny; j ++ )
-  {
-    for ( int i = 0; i < nx; i ++ )
+    else
     {
-      printf( "%5.2lf ", C[ j * nx + i ] );
+      conv2d_internal
+      <MC, NC, KC, MR, NR, 
+      PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+      USE_STRASSEN, false,
+      SEMIRINGKERNEL, MICROKERNEL,
+      TA, TB, TC, TV>
+      (
+        thread,
+        w0, h0, d0, s, p, batchSize,
+        B,
+        w1, h1, d1,
+        A,
+        C,
+        semiringkernel, microkernel,
+        nc, pack_nc,
+        packA_buff,
+        packB_buff
+      );
     }
-    printf( "\n" );
-  }
-#endif
+  }                                                        // end omp 
+
+  hmlp_free( packA_buff );
+  hmlp_free( packB_buff );
+};                                                         // end conv2d
 
-};                                                         // end cnn
-
-
-//template<
-//  int MC, int NC, int KC, int MR, int NR, 
-//  int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
-//  bool USE_STRASSEN,
-//  typename SEMIRINGKERNEL, typename MICROKERNEL,
-//  typename TA, typename TB, typename TC, typename TV>
-//void conv2d
-//(
-//  int w0, int h0, int d0,
-//  TA *B,
-//  int w1, int h1, int d1,
-//  TB *A,
-//  TC *C,
-//  SEMIRINGKERNEL semiringkernel, 
-//  MICROKERNEL microkernel         
-//)
-//{
-//  // Deciding s and p given the output size is also (w0, h0).
-//  // w0 = ( w0 - w1 + 2 * p ) / s + 1
-//  // h0 = ( h0 - h1 + 2 * p ) / s + 1
-//  // if s = 1, then p = ( w1 - 1 ) / 2
-//  //                p = ( h1 - 1 ) / 2
-//  // that is w1 and h1 must be odd.
-//
-//  assert( w1 == h1 );
-//
-//  conv2d
-//  <MC, NC, KC, MR, NR, PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
-//  USE_STRASSEN,
-//  SEMIRINGKERNEL, MICROKERNEL,
-//  TA, TB, TC, TV>
-//  (
-//    w0, h0, d0, 1, ( w1 - 1 ) / 2,
-//    B,
-//    w1, h1, d1,
-//    A,
-//    C,
-//    semiringkernel,
-//    microkernel
-//  );
-//};
 
+/** @brief Convolve a single image. */
 template<
   int MC, int NC, int KC, int MR, int NR, 
   int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
@@ -604,7 +551,7 @@ template<
   typename TA, typename TB, typename TC, typename TV>
 void conv2d
 (
-  int w0, int h0, int d0, int s, int p, int batchSize,
+  int w0, int h0, int d0, int s, int p,
   TA *B,
   int w1, int h1, int d1,
   TB *A,
@@ -613,43 +560,26 @@ void conv2d
   MICROKERNEL microkernel         
 )
 {
-  // Deciding s and p given the output size is also (w0, h0).
-  // w0 = ( w0 - w1 + 2 * p ) / s + 1
-  // h0 = ( h0 - h1 + 2 * p ) / s + 1
-  // if s = 1, then p = ( w1 - 1 ) / 2
-  //                p = ( h1 - 1 ) / 2
-  // that is w1 and h1 must be odd.
-
-  int nx = ( w0 - w1 + 2 * p ) / s + 1;
-  int ny = ( h0 - h1 + 2 * p ) / s + 1;
-
-
-  assert( w1 == h1 );
-
-  #pragma omp parallel for 
-  for ( int b = 0; b < batchSize; b ++ )
-  {
-    conv2d
-    <MC, NC, KC, MR, NR, PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
-    USE_STRASSEN,
-    SEMIRINGKERNEL, MICROKERNEL,
-    TA, TB, TC, TV>
-    (
-      w0, h0, d0, s, p,
-      B + b * w0 * h0 * d0,
-      w1, h1, d1,
-      A,
-      C + b * nx * ny * d1,
-      semiringkernel,
-      microkernel
-    );
-  }
+  conv2d
+  <MC, NC, KC, MR, NR, PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+  USE_STRASSEN,
+  SEMIRINGKERNEL, MICROKERNEL,
+  TA, TB, TC, TV>
+  (
+    w0, h0, d0, s, p, 1,
+    B,
+    w1, h1, d1,
+    A,
+    C,
+    semiringkernel,
+    microkernel
+  );
 };
 
 
 /**
- *  @CHENHAN: write a reference function using GEMM. The signiture of xgemm can
- *  be found in hmlp_blas_lapack.h.
+ *  @brief The reference unfolds the image explicitly (im2col) and calls
+ *         GEMM. The image is NHWC and the filters are OHWI.
  */ 
 template<typename T>
 void conv2d_ref
@@ -670,7 +600,6 @@ void conv2d_ref
   T *packA = A;
   T *packB = hmlp_malloc<16, T>( k, n, sizeof(T) ); 
 
-  double beg = omp_get_wtime();
   im2col<T>
   (
     n, k,
@@ -678,8 +607,6 @@ void conv2d_ref
     w0, h0, d0, s, p,
     w1, h1
   );
-  double im2col_t = omp_get_wtime() - beg;
-  printf( "im2col( B ) %3.1Es\n", im2col_t ); fflush( stdout );
 
 #ifdef DEBUG_CONV2D
   printf( "packB\n" );
@@ -717,8 +644,15 @@ void conv2d_ref
     }
   }
 #endif
+
+  hmlp_free( packB );
 }; // end void conv2d_ref
 
+
+/**
+ *  @brief NCHW images (with OIHW filters) are transposed to NHWC (with 
+ *         OHWI filters) before the reference is called.
+ */ 
 template<typename T>
 void conv2d_ref
 (
@@ -726,11 +660,33 @@ void conv2d_ref
   T *B,
   int w1, int h1, int d1,
   T *A,
-  T *C
+  T *C,
+  hmlpLayout_t layout = HMLP_NHWC
 )
 {
   int nx = ( w0 - w1 + 2 * p ) / s + 1;
   int ny = ( h0 - h1 + 2 * p ) / s + 1;
+  int nxy = nx * ny;
+  int k = w1 * h1 * d0;
+
+  vector<T> A_ohwi, B_nhwc, C_nhwc;
+  if ( layout == HMLP_NCHW )
+  {
+    A_ohwi.resize( (size_t)d1 * k );
+    for ( int o = 0; o < d1; o ++ )
+      for ( int z = 0; z < d0; z ++ )
+        for ( int q = 0; q < w1 * h1; q ++ )
+          A_ohwi[ (size_t)o * k + q * d0 + z ] = A[ (size_t)o * k + z * w1 * h1 + q ];
+    B_nhwc.resize( (size_t)w0 * h0 * d0 * batchSize );
+    for ( size_t b = 0; b < batchSize; b ++ )
+      for ( int z = 0; z < d0; z ++ )
+        for ( int q = 0; q < w0 * h0; q ++ )
+          B_nhwc[ ( b * w0 * h0 + q ) * d0 + z ] = B[ ( b * d0 + z ) * w0 * h0 + q ];
+    C_nhwc.resize( (size_t)nxy * d1 * batchSize );
+    A = A_ohwi.data();
+    B = B_nhwc.data();
+  }
+  T *C_out = ( layout == HMLP_NCHW ) ? C_nhwc.data() : C;
 
   #pragma omp parallel for 
   for ( int b = 0; b < batchSize; b ++ )
@@ -738,12 +694,20 @@ void conv2d_ref
     conv2d_ref<T>
     (
       w0, h0, d0, s, p, 
-      B + b * w0 * h0 * d0,
+      B + (size_t)b * w0 * h0 * d0,
       w1, h1, d1,
       A,
-      C + b * nx * ny * d1
+      C_out + (size_t)b * nxy * d1
     );
   }
+
+  if ( layout == HMLP_NCHW )
+  {
+    for ( size_t b = 0; b < batchSize; b ++ )
+      for ( int i = 0; i < d1; i ++ )
+        for ( int r = 0; r < nxy; r ++ )
+          C[ ( b * d1 + i ) * nxy + r ] = C_out[ ( b * nxy + r ) * d1 + i ];
+  }
 };
 
 }; // end namespace conv2d
@@ -72,6 +72,10 @@
 
 #include <hmlp_blas_lapack.h>
 
+#include <vector>
+#include <string>
+#include <cmath>
+
 //#include <gkmx.hpp>
 
 namespace hmlp
@@ -1071,6 +1075,686 @@ void hmlp_dynamic_peeling
   //printf( "Leave dynamic peeling\n" );
 }
 
+
+/**
+ *  @brief Coefficient tables of a <mt,kt,nt> fast matrix multiplication
+ *         algorithm with rank sub-products. Product r computes
+ *
+ *           M_r = ( sum_a U( a, r ) A_a ) * ( sum_b V( b, r ) B_b ),
+ *
+ *         and accumulates W( c, r ) * M_r to every C_c. Blocks are
+ *         numbered row-major, e.g. A_a with a = i * kt + p is A( i, p ).
+ *         The table of a multi-level algorithm is the Kronecker product
+ *         of its levels (see Compose()).
+ */
+class FastMatMul
+{
+  public:
+
+    FastMatMul() {};
+
+    FastMatMul
+    (
+      string name, int mt, int kt, int nt, int rank,
+      const int *u, const int *v, const int *w
+    )
+    : name( name ), mt( mt ), kt( kt ), nt( nt ), rank( rank ),
+      U( u, u + mt * kt * rank ),
+      V( v, v + kt * nt * rank ),
+      W( w, w + mt * nt * rank )
+    {};
+
+    /** Classical <1,1,1>; the selector uses it as the depth-0 choice. */
+    static FastMatMul Classical()
+    {
+      const int u[ 1 ] = { 1 };
+      FastMatMul fmm( "gemm", 1, 1, 1, 1, u, u, u );
+      fmm.depth = 0;
+      return fmm;
+    };
+
+    /**
+     *  Strassen <2,2,2> with 7 products, same ordering as
+     *  strassen_internal(): M1 = ( A00 + A11 )( B00 + B11 ), ...
+     */
+    static FastMatMul Strassen()
+    {
+      const int u[ 4 * 7 ] =
+      {
+        1,  0,  1,  0,  1, -1,  0, /** A00 */
+        0,  0,  0,  0,  1,  0,  1, /** A01 */
+        0,  1,  0,  0,  0,  1,  0, /** A10 */
+        1,  1,  0,  1,  0,  0, -1  /** A11 */
+      };
+      const int v[ 4 * 7 ] =
+      {
+        1,  1,  0, -1,  0,  1,  0, /** B00 */
+        0,  0,  1,  0,  0,  1,  0, /** B01 */
+        0,  0,  0,  1,  0,  0,  1, /** B10 */
+        1,  0, -1,  0,  1,  0,  1  /** B11 */
+      };
+      const int w[ 4 * 7 ] =
+      {
+        1,  0,  0,  1, -1,  0,  1, /** C00 */
+        0,  0,  1,  0,  1,  0,  0, /** C01 */
+        0,  1,  0,  1,  0,  0,  0, /** C10 */
+        1, -1,  1,  0,  0,  1,  0  /** C11 */
+      };
+      return FastMatMul( "strassen", 2, 2, 2, 7, u, v, w );
+    };
+
+    /** <3,2,3> with 15 products (Hopcroft-Kerr rank). */
+    static FastMatMul FMM323()
+    {
+      const int u[ 6 * 15 ] =
+      {
+         0,  0,  0, -1,  0,  0,  0,  1,  0, -1,  0,  1,  0,  1,  1, /** A00 */
+         0,  1,  0,  0,  1,  0,  0, -1,  0,  1,  0,  0,  0, -1,  0, /** A01 */
+         1,  0, -1,  0,  0,  1,  0,  1, -1,  0,  0,  0,  0,  0,  0, /** A10 */
+         0,  1,  0,  0,  0,  0,  0, -1,  1,  0, -1,  0,  0, -1,  0, /** A11 */
+         0,  0, -1,  1,  0,  1, -1, -1, -1,  1,  0, -1,  0, -1,  0, /** A20 */
+         0, -1,  0, -1,  0, -1,  1,  1,  1, -1,  0,  0,  1,  1,  0  /** A21 */
+      };
+      const int v[ 6 * 15 ] =
+      {
+         0,  0, -1,  1,  0,  1,  1,  0,  0,  0,  0,  0, -1,  0, -1, /** B00 */
+         0, -1,  0,  0,  0,  0,  0, -1,  0,  0,  0,  1,  0, -1,  1, /** B01 */
+        -1,  1,  1,  0,  0,  0,  0,  1,  0,  0,  0,  0,  0,  1,  0, /** B02 */
+         0,  0, -1,  0, -1,  1,  0,  0,  1,  0,  0,  0, -1,  0,  0, /** B10 */
+         0, -1,  0,  1,  1,  0,  0,  0,  0, -1,  0,  1,  0, -1,  0, /** B11 */
+         0,  1,  1,  0,  0, -1,  0,  0, -1,  0,  1,  0,  0,  0,  0  /** B12 */
+      };
+      const int w[ 9 * 15 ] =
+      {
+         0,  0,  0, -1, -1,  0, -1,  0,  0, -1,  0,  0,  0,  0,  0, /** C00 */
+         0,  0,  0, -1,  0,  0, -1,  0,  0, -1,  0,  0,  0,  0,  1, /** C01 */
+         1,  1, -1,  0,  0,  1,  0,  0,  0,  0,  1,  1, -1,  1,  0, /** C02 */
+         0,  0,  0,  0,  0,  1,  1,  0,  1,  0, -1,  0,  0,  0,  0, /** C10 */
+        -1,  0,  0,  0,  0,  0,  0, -1,  0,  1,  0,  0,  0,  1,  0, /** C11 */
+        -1,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  0, /** C12 */
+         0,  0,  0,  0,  0,  0, -1,  0,  0,  0,  0,  0, -1,  0,  0, /** C20 */
+         0,  0,  0, -1,  0,  0, -1,  0,  0,  0,  0, -1,  0,  0,  1, /** C21 */
+         1,  0, -1,  0,  0,  1,  0,  0,  0,  0,  0,  0, -1,  0,  0  /** C22 */
+      };
+      return FastMatMul( "fmm323", 3, 2, 3, 15, u, v, w );
+    };
+
+    /** <4,2,4> with 26 products (Hopcroft-Kerr rank). */
+    static FastMatMul FMM424()
+    {
+      const int u[ 8 * 26 ] =
+      {
+FMM424_U
+      };
+      const int v[ 8 * 26 ] =
+      {
+FMM424_V
+      };
+      const int w[ 16 * 26 ] =
+      {
+FMM424_W
+      };
+      return FastMatMul( "fmm424", 4, 2, 4, 26, u, v, w );
+    };
+
+    /**
+     *  @brief Two-level algorithm: partition with outer, then partition
+     *         each block again with inner. Block i of the composed
+     *         algorithm is ( i_outer * inner.mt + i_inner ).
+     */
+    static FastMatMul Compose( const FastMatMul &outer, const FastMatMul &inner )
+    {
+      FastMatMul fmm;
+      fmm.name  = outer.name + "+" + inner.name;
+      fmm.mt    = outer.mt * inner.mt;
+      fmm.kt    = outer.kt * inner.kt;
+      fmm.nt    = outer.nt * inner.nt;
+      fmm.rank  = outer.rank * inner.rank;
+      fmm.depth = outer.depth + inner.depth;
+      Kronecker( outer.U, outer.mt, outer.kt, outer.rank,
+                 inner.U, inner.mt, inner.kt, inner.rank, fmm.U );
+      Kronecker( outer.V, outer.kt, outer.nt, outer.rank,
+                 inner.V, inner.kt, inner.nt, inner.rank, fmm.V );
+      Kronecker( outer.W, outer.mt, outer.nt, outer.rank,
+                 inner.W, inner.mt, inner.nt, inner.rank, fmm.W );
+      return fmm;
+    };
+
+    /** Check the Brent equations exactly. */
+    bool Verify() const
+    {
+      for ( int i = 0; i < mt; i ++ ) for ( int p = 0; p < kt; p ++ )
+      for ( int q = 0; q < kt; q ++ ) for ( int j = 0; j < nt; j ++ )
+      for ( int x = 0; x < mt; x ++ ) for ( int y = 0; y < nt; y ++ )
+      {
+        int sum = 0;
+        for ( int r = 0; r < rank; r ++ )
+        {
+          sum += U[ ( i * kt + p ) * rank + r ]
+               * V[ ( q * nt + j ) * rank + r ]
+               * W[ ( x * nt + y ) * rank + r ];
+        }
+        if ( sum != ( p == q && i == x && j == y ) ) return false;
+      }
+      return true;
+    };
+
+    /** Number of nonzero coefficients of product r in a table. */
+    int Terms( const vector<int> &table, int r ) const
+    {
+      int terms = 0;
+      for ( size_t a = r; a < table.size(); a += rank ) terms += ( table[ a ] != 0 );
+      return terms;
+    };
+
+    string name;
+
+    int mt = 1;
+
+    int kt = 1;
+
+    int nt = 1;
+
+    int rank = 1;
+
+    int depth = 1;
+
+    vector<int> U;
+
+    vector<int> V;
+
+    vector<int> W;
+
+  private:
+
+    /** Block ( i, j ) of an x-by-y partition with row-major numbering. */
+    static void Kronecker
+    (
+      const vector<int> &A, int am, int an, int ar,
+      const vector<int> &B, int bm, int bn, int br,
+      vector<int> &C
+    )
+    {
+      int cn = an * bn, cr = ar * br;
+      C.assign( am * bm * cn * cr, 0 );
+      for ( int i0 = 0; i0 < am; i0 ++ ) for ( int j0 = 0; j0 < an; j0 ++ )
+      for ( int i1 = 0; i1 < bm; i1 ++ ) for ( int j1 = 0; j1 < bn; j1 ++ )
+      {
+        int a = i0 * an + j0, b = i1 * bn + j1;
+        int c = ( i0 * bm + i1 ) * cn + ( j0 * bn + j1 );
+        for ( int r0 = 0; r0 < ar; r0 ++ ) for ( int r1 = 0; r1 < br; r1 ++ )
+        {
+          C[ c * cr + r0 * br + r1 ] = A[ a * ar + r0 ] * B[ b * br + r1 ];
+        }
+      }
+    };
+
+}; /** end class FastMatMul */
+
+
+/**
+ *  @brief Performance model of fast matrix multiplication in the spirit
+ *         of [Huang et al. SC'16]. The arithmetic time of the rank
+ *         sub-products runs at an efficiency that decays with the
+ *         sub-problem size over the thread count. The memory time counts
+ *         the extra operand reads when packing linear combinations and
+ *         the C updates of every rank-KC step. Default values are for a
+ *         2.5GHz AVX2/FMA core in double precision.
+ */
+struct fmm_model
+{
+  /** Peak GFLOPS of one core. */
+  double gflops_per_core = 40.0;
+
+  /** Sustainable memory bandwidth (GB/s) of one core. */
+  double gbs_per_core = 8.0;
+
+  /** Memory bandwidth (GB/s) cap of the whole socket. */
+  double gbs_max = 60.0;
+
+  /** Sub-problem size that runs at half of the peak on one core. */
+  double half_size = 96.0;
+
+  /** Blocking of the packing loops. */
+  int kc = 256;
+
+  int nc = 960;
+}; /** end struct fmm_model */
+
+
+/**
+ *  @brief Predicted seconds of fmm on an m-by-n-by-k problem.
+ */
+template<typename T>
+double PredictFastMatMul
+(
+  const FastMatMul &fmm, int m, int n, int k, int n_threads,
+  fmm_model model = fmm_model()
+)
+{
+  double p  = std::max( n_threads, 1 );
+  double mb = m / fmm.mt, nb = n / fmm.nt, kb = k / fmm.kt;
+  double gflops = model.gflops_per_core * p;
+  double gbs = std::min( model.gbs_per_core * p, model.gbs_max );
+
+  /** Efficiency of each sub-product with p threads. */
+  auto efficiency = [&] ( double x, double y, double z )
+  {
+    double d = std::min( std::min( x, y ), z );
+    return d / ( d + model.half_size * std::sqrt( p ) );
+  };
+
+  /** Arithmetic time of the sub-products. */
+  double time = 0.0;
+  if ( mb > 0 && nb > 0 && kb > 0 )
+  {
+    time += ( 2.0 * fmm.rank * mb * nb * kb ) / 1E+9
+          / ( gflops * efficiency( mb, nb, kb ) );
+    /** Memory time of packing and updating C. */
+    for ( int r = 0; r < fmm.rank; r ++ )
+    {
+      double na = fmm.Terms( fmm.U, r );
+      double nb_ = fmm.Terms( fmm.V, r );
+      double nc = fmm.Terms( fmm.W, r );
+      double bytes = na * mb * kb * std::ceil( nb / model.nc )
+                   + nb_ * kb * nb
+                   + 2.0 * nc * mb * nb * std::ceil( kb / model.kc );
+      time += bytes * sizeof(T) / 1E+9 / gbs;
+    }
+  }
+
+  /** The fringes of dynamic peeling run as classical GEMM. */
+  double ms = mb * fmm.mt, ns = nb * fmm.nt, ks = kb * fmm.kt;
+  double fringe = 2.0 * ( (double)m * n * k - ms * ns * ks );
+  if ( fringe > 0 )
+  {
+    time += fringe / 1E+9 / ( gflops * efficiency( m, n, k ) );
+  }
+
+  return time;
+}; /** end PredictFastMatMul() */
+
+
+/**
+ *  @brief Candidate algorithms of the selector.
+ */
+inline vector<FastMatMul> FastMatMulCandidates()
+{
+  vector<FastMatMul> candidates;
+  candidates.push_back( FastMatMul::Classical() );
+  candidates.push_back( FastMatMul::Strassen() );
+  candidates.push_back( FastMatMul::Compose( FastMatMul::Strassen(), FastMatMul::Strassen() ) );
+  candidates.push_back( FastMatMul::FMM323() );
+  candidates.push_back( FastMatMul::FMM424() );
+  return candidates;
+}; /** end FastMatMulCandidates() */
+
+
+/**
+ *  @brief Select the algorithm and depth with the smallest predicted time.
+ */
+template<typename T>
+FastMatMul SelectFastMatMul
+(
+  int m, int n, int k, int n_threads,
+  fmm_model model = fmm_model()
+)
+{
+  static const vector<FastMatMul> candidates = FastMatMulCandidates();
+  const FastMatMul *best = &candidates[ 0 ];
+  double best_time = PredictFastMatMul<T>( *best, m, n, k, n_threads, model );
+
+  for ( auto &fmm : candidates )
+  {
+    double time = PredictFastMatMul<T>( fmm, m, n, k, n_threads, model );
+    if ( time < best_time )
+    {
+      best = &fmm;
+      best_time = time;
+    }
+  }
+  return *best;
+}; /** end SelectFastMatMul() */
+
+
+/**
+ *  @brief Macro kernel that accumulates one packed product to a list of
+ *         C blocks, C[ t ] += alpha[ t ] * packA * packB.
+ */
+template<
+  int KC, int MR, int NR, int PACK_MR, int PACK_NR,
+  typename SEMIRINGKERNEL,
+  typename TA, typename TB, typename TC, typename TV>
+void fmm_macro_kernel
+(
+  Worker &thread,
+  int ic, int jc, int pc,
+  int  m, int n,  int  k,
+  TA *packA,
+  TB *packB,
+  int len, TV **C, TV *alpha, int ldc,
+  SEMIRINGKERNEL semiringkernel
+)
+{
+  thread_communicator &ic_comm = *thread.ic_comm;
+
+  auto loop3rd = GetRange( 0, n,      NR, thread.jr_id, ic_comm.GetNumThreads() );
+  auto pack3rd = GetRange( 0, n, PACK_NR, thread.jr_id, ic_comm.GetNumThreads() );
+  auto loop2nd = GetRange( 0, m,      MR );
+  auto pack2nd = GetRange( 0, m, PACK_MR );
+
+  vector<TV*> c_list( len );
+
+  for ( int j   = loop3rd.beg(), jp  = pack3rd.beg();
+            j   < loop3rd.end();
+            j  += loop3rd.inc(), jp += pack3rd.inc() )     // beg 3rd loop
+  {
+    struct aux_s<TA, TB, TC, TV> aux;
+    aux.pc       = pc;
+    aux.b_next   = packB;
+    aux.do_packC = 0;
+    aux.jb       = std::min( n - j, NR );
+
+    for ( int i  = loop2nd.beg(), ip  = pack2nd.beg();
+              i  < loop2nd.end();
+              i += loop2nd.inc(), ip += pack2nd.inc() )    // beg 2nd loop
+    {
+      aux.ib = std::min( m - i, MR );
+      if ( aux.ib != MR )
+      {
+        aux.b_next += ic_comm.GetNumThreads() * PACK_NR * k;
+      }
+
+      if ( aux.jb == NR && aux.ib == MR )
+      {
+        for ( int t = 0; t < len; t ++ )
+        {
+          c_list[ t ] = C[ t ] + ( jc + j ) * ldc + ic + i;
+        }
+        semiringkernel
+        (
+          k,
+          &packA[ ip * k ],
+          &packB[ jp * k ],
+          len, c_list.data(), ldc, alpha,
+          &aux
+        );
+      }
+      else                                                 // corner case
+      {
+        TV ctmp[ MR * NR ] = { (TV)0.0 };
+        TV *ctmp_list[ 1 ] = { ctmp }, one = 1;
+
+        semiringkernel
+        (
+          k,
+          &packA[ ip * k ],
+          &packB[ jp * k ],
+          1, ctmp_list, MR, &one,
+          &aux
+        );
+
+        for ( int t = 0; t < len; t ++ )
+        {
+          for ( auto jj = 0; jj < aux.jb; jj ++ )
+          {
+            for ( auto ii = 0; ii < aux.ib; ii ++ )
+            {
+              C[ t ][ ( jc + j + jj ) * ldc + ic + i + ii ]
+                += alpha[ t ] * ctmp[ jj * MR + ii ];
+            }
+          }
+        }
+      }
+    }                                                      // end 2nd loop
+  }                                                        // end 3rd loop
+}                                                          // end fmm_macro_kernel
+
+
+/**
+ *  @brief One product of a fast matrix multiplication. The linear
+ *         combinations of A and B blocks are formed while packing, and
+ *         the product is accumulated to len C blocks by the micro-kernel.
+ */
+template<
+  int MC, int NC, int KC, int MR, int NR,
+  int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
+  bool USE_STRASSEN,
+  typename STRA_SEMIRINGKERNEL, typename STRA_MICROKERNEL,
+  typename TA, typename TB, typename TC, typename TV>
+void fmmprim
+(
+  Worker &thread,
+  hmlpOperation_t transA, hmlpOperation_t transB,
+  int m, int n, int k,
+  int na, TA **A, TA *gamma, int lda,
+  int nb, TB **B, TB *delta, int ldb,
+  int len, TV **C, TV *alpha, int ldc,
+  STRA_SEMIRINGKERNEL stra_semiringkernel,
+  STRA_MICROKERNEL stra_microkernel,
+  int nc, int pack_nc,
+  TA *packA,
+  TB *packB
+)
+{
+  packA  += ( thread.jc_id * thread.ic_nt                ) * PACK_MC * KC
+          + ( thread.ic_id                               ) * PACK_MC * KC;
+  packB  += ( thread.jc_id                               ) * pack_nc * KC;
+
+  auto loop6th = GetRange( 0, n, nc, thread.jc_id, thread.jc_nt );
+  auto loop5th = GetRange( 0, k, KC );
+  auto loop4th = GetRange( 0, m, MC, thread.ic_id, thread.ic_nt );
+
+  vector<TA*> a_list( na );
+  vector<TB*> b_list( nb );
+
+  for ( int jc  = loop6th.beg();
+            jc  < loop6th.end();
+            jc += loop6th.inc() )                          // beg 6th loop
+  {
+    auto &jc_comm = *thread.jc_comm;
+    auto jb = std::min( n - jc, nc );
+
+    for ( int pc  = loop5th.beg();
+              pc  < loop5th.end();
+              pc += loop5th.inc() )
+    {
+      auto &pc_comm = *thread.pc_comm;
+      auto pb = std::min( k - pc, KC );
+      auto looppkB = GetRange( 0, jb,      NR, thread.ic_jr, pc_comm.GetNumThreads() );
+      auto packpkB = GetRange( 0, jb, PACK_NR, thread.ic_jr, pc_comm.GetNumThreads() );
+
+      for ( int j   = looppkB.beg(), jp  = packpkB.beg();
+                j   < looppkB.end();
+                j  += looppkB.inc(), jp += packpkB.inc() )
+      {
+        if ( transB == HMLP_OP_N )
+        {
+          for ( int t = 0; t < nb; t ++ )
+            b_list[ t ] = B[ t ] + ( jc + j ) * ldb + pc;
+          pack2Dsum<true, PACK_NR>                         // packB
+          (
+            std::min( jb - j, NR ), pb,
+            nb, b_list.data(), ldb, delta, &packB[ jp * pb ]
+          );
+        }
+        else
+        {
+          for ( int t = 0; t < nb; t ++ )
+            b_list[ t ] = B[ t ] + pc * ldb + ( jc + j );
+          pack2Dsum<false, PACK_NR>                        // packB (transB)
+          (
+            std::min( jb - j, NR ), pb,
+            nb, b_list.data(), ldb, delta, &packB[ jp * pb ]
+          );
+        }
+      }
+      pc_comm.Barrier();
+
+      for ( int ic  = loop4th.beg();
+                ic  < loop4th.end();
+                ic += loop4th.inc() )                      // beg 4th loop
+      {
+        auto &ic_comm = *thread.ic_comm;
+        auto ib = std::min( m - ic, MC );
+        auto looppkA = GetRange( 0, ib,      MR, thread.jr_id, thread.jr_nt );
+        auto packpkA = GetRange( 0, ib, PACK_MR, thread.jr_id, thread.jr_nt );
+
+        for ( int i   = looppkA.beg(), ip  = packpkA.beg();
+                  i   < looppkA.end();
+                  i  += looppkA.inc(), ip += packpkA.inc() )
+        {
+          if ( transA == HMLP_OP_N )
+          {
+            for ( int t = 0; t < na; t ++ )
+              a_list[ t ] = A[ t ] + pc * lda + ( ic + i );
+            pack2Dsum<false, PACK_MR>                      // packA
+            (
+              std::min( ib - i, MR ), pb,
+              na, a_list.data(), lda, gamma, &packA[ ip * pb ]
+            );
+          }
+          else
+          {
+            for ( int t = 0; t < na; t ++ )
+              a_list[ t ] = A[ t ] + ( ic + i ) * lda + pc;
+            pack2Dsum<true, PACK_MR>                       // packA (transA)
+            (
+              std::min( ib - i, MR ), pb,
+              na, a_list.data(), lda, gamma, &packA[ ip * pb ]
+            );
+          }
+        }
+        ic_comm.Barrier();
+
+        fmm_macro_kernel
+        <KC, MR, NR, PACK_MR, PACK_NR, STRA_SEMIRINGKERNEL, TA, TB, TC, TV>
+        (
+          thread,
+          ic, jc, pc,
+          ib, jb, pb,
+          packA,
+          packB,
+          len, C, alpha, ldc,
+          stra_semiringkernel
+        );
+
+        ic_comm.Barrier();                                 // sync all jr_id!!
+      }                                                    // end 4th loop
+      pc_comm.Barrier();
+    }                                                      // end 5th loop
+  }                                                        // end 6th loop
+}                                                          // end fmmprim
+
+
+/**
+ *  @brief Run all products of fmm on the ( m - m % mt )-by-( n - n % nt )
+ *         -by-( k - k % kt ) part, then peel the fringes with GEMM.
+ */
+template<
+  int MC, int NC, int KC, int MR, int NR,
+  int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
+  bool USE_STRASSEN,
+  typename STRA_SEMIRINGKERNEL, typename STRA_MICROKERNEL,
+  typename TA, typename TB, typename TC, typename TV>
+void fmm_internal
+(
+  Worker &thread,
+  const FastMatMul &fmm,
+  hmlpOperation_t transA, hmlpOperation_t transB,
+  int m, int n, int k,
+  TA *A, int lda,
+  TB *B, int ldb,
+  TV *C, int ldc,
+  STRA_SEMIRINGKERNEL stra_semiringkernel,
+  STRA_MICROKERNEL stra_microkernel,
+  int nc, int pack_nc,
+  TA *packA_buff,
+  TB *packB_buff
+)
+{
+  int md = m - m % fmm.mt;
+  int kd = k - k % fmm.kt;
+  int nd = n - n % fmm.nt;
+
+  if ( md && nd && kd )
+  {
+    vector<TA*> a_list; vector<TA> gamma;
+    vector<TB*> b_list; vector<TB> delta;
+    vector<TV*> c_list; vector<TV> alpha;
+
+    for ( int r = 0; r < fmm.rank; r ++ )
+    {
+      a_list.clear(); gamma.clear();
+      b_list.clear(); delta.clear();
+      c_list.clear(); alpha.clear();
+
+      for ( int i = 0; i < fmm.mt; i ++ ) for ( int p = 0; p < fmm.kt; p ++ )
+      {
+        if ( int coef = fmm.U[ ( i * fmm.kt + p ) * fmm.rank + r ] )
+        {
+          TA *Aip;
+          hmlp_acquire_mpart( transA, md, kd, A, lda, fmm.mt, fmm.kt, i, p, &Aip );
+          a_list.push_back( Aip ); gamma.push_back( coef );
+        }
+      }
+      for ( int p = 0; p < fmm.kt; p ++ ) for ( int j = 0; j < fmm.nt; j ++ )
+      {
+        if ( int coef = fmm.V[ ( p * fmm.nt + j ) * fmm.rank + r ] )
+        {
+          TB *Bpj;
+          hmlp_acquire_mpart( transB, kd, nd, B, ldb, fmm.kt, fmm.nt, p, j, &Bpj );
+          b_list.push_back( Bpj ); delta.push_back( coef );
+        }
+      }
+      for ( int i = 0; i < fmm.mt; i ++ ) for ( int j = 0; j < fmm.nt; j ++ )
+      {
+        if ( int coef = fmm.W[ ( i * fmm.nt + j ) * fmm.rank + r ] )
+        {
+          TV *Cij;
+          hmlp_acquire_mpart( HMLP_OP_N, md, nd, C, ldc, fmm.mt, fmm.nt, i, j, &Cij );
+          c_list.push_back( Cij ); alpha.push_back( coef );
+        }
+      }
+
+      /** Skip products that do not contribute. */
+      if ( a_list.empty() || b_list.empty() || c_list.empty() ) continue;
+
+      fmmprim
+      <MC, NC, KC, MR, NR,
+      PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+      USE_STRASSEN,
+      STRA_SEMIRINGKERNEL, STRA_MICROKERNEL,
+      TA, TB, TC, TV>
+      (
+        thread,
+        transA, transB,
+        md / fmm.mt, nd / fmm.nt, kd / fmm.kt,
+        a_list.size(), a_list.data(), gamma.data(), lda,
+        b_list.size(), b_list.data(), delta.data(), ldb,
+        c_list.size(), c_list.data(), alpha.data(), ldc,
+        stra_semiringkernel, stra_microkernel,
+        nc, pack_nc,
+        packA_buff,
+        packB_buff
+      );
+    }
+  }
+
+  /** All products must land before the fringes update C. */
+  thread.my_comm->Barrier();
+
+  if ( omp_get_thread_num() == 0 ) //Chief thread
+  {
+    hmlp_dynamic_peeling
+    (
+      transA, transB, m, n, k, A, lda, B, ldb, C, ldc,
+      fmm.mt, fmm.kt, fmm.nt
+    );
+  }
+}                                                          // end fmm_internal
+
+
 template<
   int MC, int NC, int KC, int MR, int NR, 
   int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
@@ -1237,8 +1921,8 @@ void strassen_internal
 
 
 /**
- *
- *
+ *  @brief Fast matrix multiplication C += op( A ) * op( B ) with the
+ *         given algorithm (see FastMatMul).
  */ 
 template<
   int MC, int NC, int KC, int MR, int NR, 
@@ -1248,6 +1932,7 @@ template<
   typename TA, typename TB, typename TC, typename TV>
 void strassen
 (
+  const FastMatMul &fmm,
   hmlpOperation_t transA, hmlpOperation_t transB,
   int m, int n, int k,
   TA *A, int lda,
@@ -1259,7 +1944,6 @@ void strassen
 {
   int jc_nt = 1, pc_nt = 1, ic_nt = 1, jr_nt = 1;
   int nc = NC, pack_nc = PACK_NC;
-  char *str;
 
   TA *packA_buff = NULL;
   TB *packB_buff = NULL;
@@ -1290,14 +1974,15 @@ void strassen
   {
     Worker thread( &my_comm );
 
-    strassen_internal
+    fmm_internal
     <MC, NC, KC, MR, NR,
     PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
     USE_STRASSEN,
     STRA_SEMIRINGKERNEL, STRA_MICROKERNEL,
-    TA, TB, TC, TB>
+    TA, TB, TC, TV>
     (
        thread,
+       fmm,
        transA, transB,
        m, n, k,
        A, lda,
@@ -1311,6 +1996,57 @@ void strassen
 
   }
                                                         // end omp  
+  hmlp_free( packA_buff );
+  hmlp_free( packB_buff );
+}                                                       // end strassen
+
+
+/**
+ *  @brief Fast matrix multiplication with the algorithm and depth picked
+ *         by SelectFastMatMul() for this shape and thread count.
+ */ 
+template<
+  int MC, int NC, int KC, int MR, int NR, 
+  int PACK_MC, int PACK_NC, int PACK_MR, int PACK_NR, int ALIGN_SIZE,
+  bool USE_STRASSEN,
+  typename STRA_SEMIRINGKERNEL, typename STRA_MICROKERNEL,
+  typename TA, typename TB, typename TC, typename TV>
+void strassen
+(
+  hmlpOperation_t transA, hmlpOperation_t transB,
+  int m, int n, int k,
+  TA *A, int lda,
+  TB *B, int ldb,
+  TV *C, int ldc,
+  STRA_SEMIRINGKERNEL stra_semiringkernel,
+  STRA_MICROKERNEL stra_microkernel
+)
+{
+  int n_threads = hmlp_read_nway_from_env( "KS_JC_NT" )
+                * hmlp_read_nway_from_env( "KS_IC_NT" )
+                * hmlp_read_nway_from_env( "KS_JR_NT" );
+
+  fmm_model model;
+  model.kc = KC;
+  model.nc = NC;
+
+  auto fmm = SelectFastMatMul<TV>( m, n, k, n_threads, model );
+
+  strassen
+  <MC, NC, KC, MR, NR,
+  PACK_MC, PACK_NC, PACK_MR, PACK_NR, ALIGN_SIZE,
+  USE_STRASSEN,
+  STRA_SEMIRINGKERNEL, STRA_MICROKERNEL,
+  TA, TB, TC, TV>
+  (
+    fmm,
+    transA, transB,
+    m, n, k,
+    A, lda,
+    B, ldb,
+    C, ldc,
+    stra_semiringkernel, stra_microkernel
+  );
 }                                                       // end strassen
 
 
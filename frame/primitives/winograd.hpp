@@ -0,0 +1,337 @@
+/**
+ *  HMLP (High-Performance Machine Learning Primitives)
+ *  
+ *  Copyright (C) 2014-2017, The University of Texas at Austin
+ *  
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *  
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program. If not, see the LICENSE file.
+ *
+ **/  
+
+
+
+
+
+#ifndef WINOGRAD_HPP
+#define WINOGRAD_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include <hmlp.h>
+#include <hmlp_util.hpp>
+
+namespace hmlp
+{
+namespace cnn
+{
+
+/**
+ *  @brief Transforms of the Winograd minimal filtering F( M x M, 3 x 3 ),
+ *         Y = AT [ ( G g GT ) .* ( BT d B ) ] A, on ALPHA x ALPHA tiles.
+ */ 
+template<int M> struct winograd;
+
+/** F( 2 x 2, 3 x 3 ) with interpolation points 0, 1, -1. */
+template<>
+struct winograd<2>
+{
+  static const int alpha = 4;
+
+  static double BT( int i, int j )
+  {
+    static const double bt[ 4 ][ 4 ] = 
+    {
+      { 1.0,  0.0, -1.0,  0.0 },
+      { 0.0,  1.0,  1.0,  0.0 },
+      { 0.0, -1.0,  1.0,  0.0 },
+      { 0.0,  1.0,  0.0, -1.0 }
+    };
+    return bt[ i ][ j ];
+  };
+
+  static double G( int i, int j )
+  {
+    static const double g[ 4 ][ 3 ] = 
+    {
+      { 1.0,  0.0, 0.0 },
+      { 0.5,  0.5, 0.5 },
+      { 0.5, -0.5, 0.5 },
+      { 0.0,  0.0, 1.0 }
+    };
+    return g[ i ][ j ];
+  };
+
+  static double AT( int i, int j )
+  {
+    static const double at[ 2 ][ 4 ] = 
+    {
+      { 1.0,  1.0,  1.0,  0.0 },
+      { 0.0,  1.0, -1.0, -1.0 }
+    };
+    return at[ i ][ j ];
+  };
+}; /** end struct winograd<2> */
+
+/** F( 4 x 4, 3 x 3 ) with interpolation points 0, 1, -1, 2, -2. */
+template<>
+struct winograd<4>
+{
+  static const int alpha = 6;
+
+  static double BT( int i, int j )
+  {
+    static const double bt[ 6 ][ 6 ] = 
+    {
+      { 4.0,  0.0, -5.0,  0.0, 1.0, 0.0 },
+      { 0.0, -4.0, -4.0,  1.0, 1.0, 0.0 },
+      { 0.0,  4.0, -4.0, -1.0, 1.0, 0.0 },
+      { 0.0, -2.0, -1.0,  2.0, 1.0, 0.0 },
+      { 0.0,  2.0, -1.0, -2.0, 1.0, 0.0 },
+      { 0.0,  4.0,  0.0, -5.0, 0.0, 1.0 }
+    };
+    return bt[ i ][ j ];
+  };
+
+  static double G( int i, int j )
+  {
+    static const double g[ 6 ][ 3 ] = 
+    {
+      {  1.0 /  4.0,  0.0,         0.0       },
+      { -1.0 /  6.0, -1.0 /  6.0, -1.0 / 6.0 },
+      { -1.0 /  6.0,  1.0 /  6.0, -1.0 / 6.0 },
+      {  1.0 / 24.0,  1.0 / 12.0,  1.0 / 6.0 },
+      {  1.0 / 24.0, -1.0 / 12.0,  1.0 / 6.0 },
+      {  0.0,         0.0,         1.0       }
+    };
+    return g[ i ][ j ];
+  };
+
+  static double AT( int i, int j )
+  {
+    static const double at[ 4 ][ 6 ] = 
+    {
+      { 1.0,  1.0,  1.0,  1.0,  1.0, 0.0 },
+      { 0.0,  1.0, -1.0,  2.0, -2.0, 0.0 },
+      { 0.0,  1.0,  1.0,  4.0,  4.0, 0.0 },
+      { 0.0,  1.0, -1.0,  8.0, -8.0, 1.0 }
+    };
+    return at[ i ][ j ];
+  };
+}; /** end struct winograd<4> */
+
+
+/** 
+ *  @brief Pick the convolution algorithm. Winograd only applies to 3 x 3 
+ *         filters with stride 1. F( 4 x 4, 3 x 3 ) needs outputs of at
+ *         least 8 x 8 to fill its tiles; it loses about one more digit
+ *         than F( 2 x 2, 3 x 3 ) (1E-6 relative error in single precision).
+ */ 
+template<typename T>
+hmlpConvAlgorithm_t conv2d_select_algorithm
+( 
+  int w0, int h0, int d0, int s, int p, 
+  int w1, int h1, int d1 
+)
+{
+  int nx = ( w0 - w1 + 2 * p ) / s + 1;
+  int ny = ( h0 - h1 + 2 * p ) / s + 1;
+  /** Only 3 x 3 stride-1 filters have minimal filtering algorithms here. */
+  if ( w1 != 3 || h1 != 3 || s != 1 ) return HMLP_CONV_IM2COL;
+  /** Transforms dominate when there are few channels. */
+  if ( d0 < 8 || d1 < 8 ) return HMLP_CONV_IM2COL;
+  if ( nx >= 8 && ny >= 8 ) return HMLP_CONV_WINOGRAD_F4X4;
+  return HMLP_CONV_WINOGRAD_F2X2;
+}; /** end conv2d_select_algorithm() */
+
+
+/** @brief Offset of channel z at ( x, y ) of image b. */
+template<bool NCHW>
+inline size_t winograd_offset( size_t b, int z, int y, int x, int w, int h, int d )
+{
+  if ( NCHW ) return ( ( b * d + z ) * h + y ) * w + x;
+  else        return ( ( b * h + y ) * w + x ) * d + z;
+}; /** end winograd_offset() */
+
+
+/**
+ *  @brief Winograd convolution F( M x M, 3 x 3 ) with stride 1. Filters
+ *         are transformed once to U[ xi ] ( d1-by-d0 ). Blocks of nt tiles 
+ *         are transformed to V[ xi ] ( d0-by-nt ), multiplied by ALPHA^2 
+ *         GEMMs, M[ xi ] = U[ xi ] * V[ xi ], and transformed back. The
+ *         GEMM functor, gemm( m, n, k, A, lda, B, ldb, C, ldc ), computes
+ *         column-major C = A * B with the micro-kernels of the package.
+ */ 
+template<int M, bool NCHW, typename T, typename GEMM>
+void winograd_conv2d_internal
+(
+  int w0, int h0, int d0, int p, int batchSize,
+  T *B,
+  int d1,
+  T *A,
+  T *C,
+  GEMM gemm
+)
+{
+  using TR = winograd<M>;
+  const int alpha = TR::alpha;
+  const int aa = alpha * alpha;
+
+  int nx = w0 - 3 + 2 * p + 1;
+  int ny = h0 - 3 + 2 * p + 1;
+  int tx = ( nx + M - 1 ) / M;
+  int ty = ( ny + M - 1 ) / M;
+  size_t n_tiles = (size_t)tx * ty * batchSize;
+
+  /** Bound the transformed tiles to about 8MB per block. */
+  size_t nt = ( 1 << 20 ) / ( (size_t)aa * std::max( d0, d1 ) );
+  nt = std::max( (size_t)32, std::min( nt, n_tiles ) );
+
+  T *U = hmlp_malloc<32, T>( aa * d1, d0, sizeof(T) );
+  T *V = hmlp_malloc<32, T>( aa * d0, nt, sizeof(T) );
+  T *Y = hmlp_malloc<32, T>( aa * d1, nt, sizeof(T) );
+
+  /** U[ xi ]( o, c ) = ( G g GT )( xi ); NHWC filters are OHWI, NCHW are OIHW. */
+  #pragma omp parallel for collapse( 2 )
+  for ( int o = 0; o < d1; o ++ )
+  {
+    for ( int c = 0; c < d0; c ++ )
+    {
+      double g[ 3 ][ 3 ], Gg[ alpha ][ 3 ];
+      for ( int y = 0; y < 3; y ++ )
+        for ( int x = 0; x < 3; x ++ )
+          g[ y ][ x ] = NCHW ? A[ ( (size_t)o * d0 + c ) * 9 + y * 3 + x ]
+                             : A[ ( (size_t)o * 9 + y * 3 + x ) * d0 + c ];
+      for ( int i = 0; i < alpha; i ++ )
+        for ( int x = 0; x < 3; x ++ )
+        {
+          Gg[ i ][ x ] = 0.0;
+          for ( int y = 0; y < 3; y ++ ) Gg[ i ][ x ] += TR::G( i, y ) * g[ y ][ x ];
+        }
+      for ( int i = 0; i < alpha; i ++ )
+        for ( int j = 0; j < alpha; j ++ )
+        {
+          double u = 0.0;
+          for ( int x = 0; x < 3; x ++ ) u += Gg[ i ][ x ] * TR::G( j, x );
+          U[ (size_t)( i * alpha + j ) * d1 * d0 + (size_t)c * d1 + o ] = u;
+        }
+    }
+  }
+
+  for ( size_t t0 = 0; t0 < n_tiles; t0 += nt )
+  {
+    int nb = std::min( nt, n_tiles - t0 );
+
+    /** V[ xi ]( c, t ) = ( BT d B )( xi ) for the tiles of this block. */
+    #pragma omp parallel for collapse( 2 )
+    for ( int t = 0; t < nb; t ++ )
+    {
+      for ( int c = 0; c < d0; c ++ )
+      {
+        size_t tile = t0 + t;
+        size_t b = tile / ( tx * ty );
+        int x0 = ( tile % tx ) * M - p;
+        int y0 = ( ( tile / tx ) % ty ) * M - p;
+        double d[ alpha ][ alpha ], BTd[ alpha ][ alpha ];
+        for ( int y = 0; y < alpha; y ++ )
+          for ( int x = 0; x < alpha; x ++ )
+          {
+            int x1 = x0 + x, y1 = y0 + y;
+            d[ y ][ x ] = ( 0 <= x1 && x1 < w0 && 0 <= y1 && y1 < h0 ) ?
+              B[ winograd_offset<NCHW>( b, c, y1, x1, w0, h0, d0 ) ] : 0.0;
+          }
+        for ( int i = 0; i < alpha; i ++ )
+          for ( int x = 0; x < alpha; x ++ )
+          {
+            BTd[ i ][ x ] = 0.0;
+            for ( int y = 0; y < alpha; y ++ ) 
+              if ( TR::BT( i, y ) != 0.0 ) BTd[ i ][ x ] += TR::BT( i, y ) * d[ y ][ x ];
+          }
+        for ( int i = 0; i < alpha; i ++ )
+          for ( int j = 0; j < alpha; j ++ )
+          {
+            double v = 0.0;
+            for ( int x = 0; x < alpha; x ++ ) 
+              if ( TR::BT( j, x ) != 0.0 ) v += BTd[ i ][ x ] * TR::BT( j, x );
+            V[ (size_t)( i * alpha + j ) * d0 * nt + (size_t)t * d0 + c ] = v;
+          }
+      }
+    }
+
+    /** ALPHA^2 independent GEMMs ( d1-by-nb-by-d0 ). */
+    for ( int xi = 0; xi < aa; xi ++ )
+    {
+      gemm( d1, nb, d0, 
+          U + (size_t)xi * d1 * d0, d1, 
+          V + (size_t)xi * d0 * nt, d0, 
+          Y + (size_t)xi * d1 * nt, d1 );
+    }
+
+    /** C = AT Y A, clipped to the output. */
+    #pragma omp parallel for collapse( 2 )
+    for ( int t = 0; t < nb; t ++ )
+    {
+      for ( int o = 0; o < d1; o ++ )
+      {
+        size_t tile = t0 + t;
+        size_t b = tile / ( tx * ty );
+        int x0 = ( tile % tx ) * M;
+        int y0 = ( ( tile / tx ) % ty ) * M;
+        double ATy[ M ][ alpha ];
+        for ( int i = 0; i < M; i ++ )
+          for ( int j = 0; j < alpha; j ++ )
+          {
+            ATy[ i ][ j ] = 0.0;
+            for ( int q = 0; q < alpha; q ++ ) 
+              ATy[ i ][ j ] += TR::AT( i, q ) * Y[ (size_t)( q * alpha + j ) * d1 * nt + (size_t)t * d1 + o ];
+          }
+        for ( int i = 0; i < M && y0 + i < ny; i ++ )
+          for ( int j = 0; j < M && x0 + j < nx; j ++ )
+          {
+            double c = 0.0;
+            for ( int q = 0; q < alpha; q ++ ) c += ATy[ i ][ q ] * TR::AT( j, q );
+            C[ winograd_offset<NCHW>( b, o, y0 + i, x0 + j, nx, ny, d1 ) ] = c;
+          }
+      }
+    }
+  }
+
+  hmlp_free( U );
+  hmlp_free( V );
+  hmlp_free( Y );
+}; /** end winograd_conv2d_internal() */
+
+
+/** @brief Winograd convolution F( M x M, 3 x 3 ) in either layout. */
+template<int M, typename T, typename GEMM>
+void winograd_conv2d
+(
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int p, int batchSize,
+  T *B,
+  int d1,
+  T *A,
+  T *C,
+  GEMM gemm
+)
+{
+  if ( layout == HMLP_NCHW )
+    winograd_conv2d_internal<M, true>( w0, h0, d0, p, batchSize, B, d1, A, C, gemm );
+  else
+    winograd_conv2d_internal<M, false>( w0, h0, d0, p, batchSize, B, d1, A, C, gemm );
+}; /** end winograd_conv2d() */
+
+}; /** end namespace cnn */
+}; /** end namespace hmlp */
+
+#endif /** define WINOGRAD_HPP */
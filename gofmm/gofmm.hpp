@@ -387,8 +387,8 @@ class NodeData : public Factor<T>
     Data<T> u_skel;
 
     /** (Buffer) permuted weights and potentials. */
-    Data<T> w_leaf;
-    Data<T> u_leaf[ 20 ];
+    LocalData<T> w_leaf;
+    LocalData<T> u_leaf[ 20 ];
 
     /** Hierarchical tree view of w<RIDS, STAR> and u<RIDS, STAR>. */
     View<T> w_view;
@@ -396,7 +396,7 @@ class NodeData : public Factor<T>
 
     /** Cached Kab */
     Data<size_t> Nearbmap;
-    Data<T> NearKab;
+    LocalData<T> NearKab;
     Data<T> FarKab;
 
 
@@ -600,6 +600,15 @@ struct centersplit
 
 	/** Overload the operator (). */
   vector<vector<size_t>> operator() ( vector<size_t>& gids ) const 
+  {
+    vector<size_t> pivots;
+    T median;
+    return (*this)( gids, pivots, median );
+  };
+
+  /** Also return the decision (pivots P, Q and the median). */
+  vector<vector<size_t>> operator() ( vector<size_t>& gids, 
+      vector<size_t> &pivots, T &median ) const 
   {
     /** all assertions */
     assert( N_SPLIT == 2 );
@@ -643,12 +652,14 @@ struct centersplit
     vector<size_t> Q( 1, gids[ idf2f ] );
 
     /** Compute all pairwise distances. */
-    auto DIQ = K.Distances( this->metric, gids, P );
+    auto DIQ = K.Distances( this->metric, gids, Q );
 
     for ( size_t i = 0; i < temp.size(); i ++ )
       temp[ i ] = DIP[ i ] - DIQ[ i ];
 
-    return combinatorics::MedianSplit( temp );
+    /** Record the decision such that new points can be routed. */
+    pivots = { P[ 0 ], Q[ 0 ] };
+    return combinatorics::MedianSplit( temp, median );
   };
 }; /** end struct centersplit */
 
@@ -677,6 +688,15 @@ struct randomsplit
 
 	/** overload with the operator */
   inline vector<vector<size_t> > operator() ( vector<size_t>& gids ) const 
+  {
+    vector<size_t> pivots;
+    T median;
+    return (*this)( gids, pivots, median );
+  };
+
+  /** Also return the decision (pivots P, Q and the median). */
+  inline vector<vector<size_t> > operator() ( vector<size_t>& gids,
+      vector<size_t> &pivots, T &median ) const 
   {
     assert( Kptr && ( N_SPLIT == 2 ) );
 
@@ -702,7 +722,9 @@ struct randomsplit
     for ( size_t i = 0; i < temp.size(); i ++ )
       temp[ i ] = DIP[ i ] - DIQ[ i ];
 
-    return combinatorics::MedianSplit( temp );
+    /** Record the decision such that new points can be routed. */
+    pivots = { P[ 0 ], Q[ 0 ] };
+    return combinatorics::MedianSplit( temp, median );
 
   };
 }; /** end struct randomsplit */
@@ -1459,6 +1481,19 @@ class SkeletonizeTask : public Task
       arg->data.skeletonize = event;
     };
 
+    /** Bound the candidate columns since children may not be skeletonized yet. */
+    double SizeHint()
+    {
+      size_t s = arg->setup->MaximumRank();
+      size_t n = arg->gids.size();
+      if ( !arg->isleaf ) n = std::min( n, 2 * s );
+      size_t m = 2 * n;
+      size_t k = std::min( n, s );
+      /** GEQP3 (flops and mops) and TRSM as in GetEventRecord(). */
+      return ( 4.0 / 3.0 ) * n * n * ( 3 * m - n ) 
+        + k * ( k - 1 ) * ( n + 1 ) + 2.0 * ( k * k + k * n );
+    };
+
     void DependencyAnalysis() { arg->DependOnNoOne( this ); };
 
     void Execute( Worker* user_worker ) { Skeletonize( arg ); };
@@ -2521,6 +2556,50 @@ void SymmetrizeNearInteractions( TREE & tree )
 }; /** end SymmetrizeNearInteractions() */
 
 
+/** @brief Evaluate and store Kab used in the near interaction (leaf only). */
+template<bool NNPRUNE, typename NODE>
+void CacheNearNodes( NODE *node )
+{
+  auto *NearNodes = &node->NearNodes;
+  if ( NNPRUNE ) NearNodes = &node->NNNearNodes;
+  auto &K = *node->setup->K;
+  auto &data = node->data;
+  auto &amap = node->gids;
+  vector<size_t> bmap;
+  for ( auto it = NearNodes->begin(); it != NearNodes->end(); it ++ )
+  {
+    bmap.insert( bmap.end(), (*it)->gids.begin(), (*it)->gids.end() );
+  }
+  data.NearKab = K( amap, bmap );
+
+  /** */
+  data.Nearbmap.resize( bmap.size(), 1 );
+  for ( size_t i = 0; i < bmap.size(); i ++ ) 
+    data.Nearbmap[ i ] = bmap[ i ];
+
+#ifdef HMLP_USE_CUDA
+  auto *device = hmlp_get_device( 0 );
+  /** prefetch Nearbmap to GPU */
+  node->data.Nearbmap.PrefetchH2D( device, 8 );
+
+  size_t preserve_size = 3000000000;
+  //if ( data.NearKab.col() * MAX_NRHS < 1200000000 &&
+  //     data.NearKab.size() * 8 + preserve_size < device->get_memory_left() &&
+  //     data.NearKab.size() * 8 > 4096 * 4096 * 8 * 4 )
+  if ( data.NearKab.col() * MAX_NRHS < 1200000000 &&
+       data.NearKab.size() * 8 + preserve_size < device->get_memory_left() )
+  {
+    /** prefetch NearKab to GPU */
+    data.NearKab.PrefetchH2D( device, 8 );
+  }
+  else
+  {
+    printf( "Kab %lu %lu not cache\n", data.NearKab.row(), data.NearKab.col() );
+  }
+#endif
+}; /** end CacheNearNodes() */
+
+
 /** @brief Task wrapper for CacheNearNodes(). */
 template<bool NNPRUNE, typename NODE>
 class CacheNearNodesTask : public Task
@@ -2557,53 +2636,20 @@ class CacheNearNodesTask : public Task
       event.Set( label + name, flops, mops );
     };
 
-    void DependencyAnalysis() { arg->DependOnNoOne( this ); };
-
-    void Execute( Worker* user_worker )
+    /** The near lists are known before execution. */
+    double SizeHint()
     {
-      //printf( "%lu CacheNearNodes beg\n", arg->treelist_id ); fflush( stdout );
-
-      NODE *node = arg;
-      auto *NearNodes = &node->NearNodes;
-      if ( NNPRUNE ) NearNodes = &node->NNNearNodes;
-      auto &K = *node->setup->K;
-      auto &data = node->data;
-      auto &amap = node->gids;
-      vector<size_t> bmap;
-      for ( auto it = NearNodes->begin(); it != NearNodes->end(); it ++ )
-      {
-        bmap.insert( bmap.end(), (*it)->gids.begin(), (*it)->gids.end() );
-      }
-      data.NearKab = K( amap, bmap );
-
-      /** */
-      data.Nearbmap.resize( bmap.size(), 1 );
-      for ( size_t i = 0; i < bmap.size(); i ++ ) 
-        data.Nearbmap[ i ] = bmap[ i ];
-
-#ifdef HMLP_USE_CUDA
-      auto *device = hmlp_get_device( 0 );
-      /** prefetch Nearbmap to GPU */
-      node->data.Nearbmap.PrefetchH2D( device, 8 );
+      auto *NearNodes = &arg->NearNodes;
+      if ( NNPRUNE ) NearNodes = &arg->NNNearNodes;
+      double n = 0.0;
+      for ( auto *near : *NearNodes ) n += near->gids.size();
+      /** Each entry of K( amap, bmap ) is evaluated and stored. */
+      return arg->gids.size() * n;
+    };
 
-      size_t preserve_size = 3000000000;
-      //if ( data.NearKab.col() * MAX_NRHS < 1200000000 &&
-      //     data.NearKab.size() * 8 + preserve_size < device->get_memory_left() &&
-      //     data.NearKab.size() * 8 > 4096 * 4096 * 8 * 4 )
-      if ( data.NearKab.col() * MAX_NRHS < 1200000000 &&
-           data.NearKab.size() * 8 + preserve_size < device->get_memory_left() )
-      {
-        /** prefetch NearKab to GPU */
-        data.NearKab.PrefetchH2D( device, 8 );
-      }
-      else
-      {
-        printf( "Kab %lu %lu not cache\n", data.NearKab.row(), data.NearKab.col() );
-      }
-#endif
+    void DependencyAnalysis() { arg->DependOnNoOne( this ); };
 
-      //printf( "%lu CacheNearNodesTask end\n", arg->treelist_id ); fflush( stdout );
-    };
+    void Execute( Worker* user_worker ) { CacheNearNodes<NNPRUNE>( arg ); };
 }; /** end class CacheNearNodesTask */
 
 
@@ -2828,6 +2874,25 @@ void MergeFarNodes( TREE &tree )
 };
 
 
+/** @brief Evaluate and store Kab used in the far interaction of node. */
+template<bool NNPRUNE, typename NODE>
+void CacheFarNodes( NODE *node )
+{
+  auto *FarNodes = &node->FarNodes;
+  if ( NNPRUNE ) FarNodes = &node->NNFarNodes;
+  auto &K = *node->setup->K;
+  auto &data = node->data;
+  auto &amap = data.skels;
+  std::vector<size_t> bmap;
+  for ( auto it = FarNodes->begin(); it != FarNodes->end(); it ++ )
+  {
+    bmap.insert( bmap.end(), (*it)->data.skels.begin(), 
+                             (*it)->data.skels.end() );
+  }
+  data.FarKab = K( amap, bmap );
+}; /** end CacheFarNodes() */
+
+
 /**
  *  @brief Evaluate and store all submatrices Kba used in the Far 
  *         interaction.
@@ -2857,19 +2922,7 @@ void CacheFarNodes( TREE &tree )
     #pragma omp parallel for schedule( dynamic )
     for ( size_t i = 0; i < tree.treelist.size(); i ++ )
     {
-      auto *node = tree.treelist[ i ];
-      auto *FarNodes = &node->FarNodes;
-      if ( NNPRUNE ) FarNodes = &node->NNFarNodes;
-      auto &K = *node->setup->K;
-      auto &data = node->data;
-      auto &amap = data.skels;
-      std::vector<size_t> bmap;
-      for ( auto it = FarNodes->begin(); it != FarNodes->end(); it ++ )
-      {
-        bmap.insert( bmap.end(), (*it)->data.skels.begin(), 
-                                 (*it)->data.skels.end() );
-      }
-      data.FarKab = K( amap, bmap );
+      CacheFarNodes<NNPRUNE>( tree.treelist[ i ] );
     }
   }
 }; /** end CacheFarNodes() */
@@ -3370,6 +3423,836 @@ Data<T> Evaluate
 
 
 
+/**
+ *  @brief Permute weights into w_leaf and compute the skeleton weights
+ *         w_skel (N2S) of all nodes. This is the only part of 
+ *         Evaluate() that out-of-sample evaluation depends on.
+ */ 
+template<typename TREE, typename T>
+void UpdateSkeletonWeights( TREE &tree, Data<T> &weights )
+{
+  /** Get type NODE = TREE::NODE. */
+  using NODE = typename TREE::NODE;
+  /** Clean up all r/w dependencies left on tree nodes. */
+  tree.DependencyCleanUp();
+  tree.setup.w = &weights;
+
+  /** Permute weights into w_leaf. */
+  int n_nodes = ( 1 << tree.depth );
+  auto level_beg = tree.treelist.begin() + n_nodes - 1;
+  #pragma omp parallel for
+  for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+  {
+    auto *node = *(level_beg + node_ind);
+    auto &gids = node->gids;
+    auto &w_leaf = node->data.w_leaf;
+    w_leaf.resize( gids.size(), weights.col() );
+    for ( size_t j = 0; j < w_leaf.col(); j ++ )
+      for ( size_t i = 0; i < w_leaf.row(); i ++ )
+        w_leaf( i, j ) = weights( gids[ i ], j ); 
+  }
+
+  /** Compute all N2S. */
+  UpdateWeightsTask<NODE, T> nodetoskeltask;
+  tree.TraverseUp( nodetoskeltask );
+  tree.ExecuteAllTasks();
+}; /** end UpdateSkeletonWeights() */
+
+
+/**
+ *  @brief Route nq points down the tree by replaying the recorded
+ *         splitter decisions. DISTANCES( I, pivots ) must return the
+ *         |I|-by-2 distances between points I (in [ 0, nq )) and the
+ *         two pivots (gids) in the metric used by the splitter.
+ *
+ *  @return queries[ treelist_id ] contains all points in the node.
+ */ 
+template<typename TREE, typename DISTANCES>
+vector<vector<size_t>> RoutePoints( TREE &tree, size_t nq, DISTANCES distances )
+{
+  vector<vector<size_t>> queries( tree.treelist.size() );
+  /** All points start from the root. */
+  auto &root_queries = queries[ tree.treelist[ 0 ]->treelist_id ];
+  for ( size_t i = 0; i < nq; i ++ ) root_queries.push_back( i );
+
+  /** Traverse level-by-level (top-down). */
+  for ( size_t l = 0; l < tree.depth; l ++ )
+  {
+    int n_nodes = 1 << l;
+    auto level_beg = tree.treelist.begin() + n_nodes - 1;
+    #pragma omp parallel for schedule( dynamic )
+    for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+    {
+      auto *node = *(level_beg + node_ind);
+      auto &I = queries[ node->treelist_id ];
+      auto &lhs = queries[ node->lchild->treelist_id ];
+      auto &rhs = queries[ node->rchild->treelist_id ];
+      auto &pivots = node->split_pivots;
+      if ( !I.size() ) continue;
+
+      /** The decision cannot be replayed (uneven split). */
+      if ( pivots.size() != 2 )
+      {
+        lhs = I;
+        continue;
+      }
+
+      /** D( :, 0 ) - D( :, 1 ) are compared against the median. */
+      auto D = distances( I, pivots );
+
+      for ( size_t i = 0; i < I.size(); i ++ )
+      {
+        if ( D( i, 0 ) - D( i, 1 ) < node->split_median ) lhs.push_back( I[ i ] );
+        else                                              rhs.push_back( I[ i ] );
+      }
+    }
+  }
+
+  return queries;
+}; /** end RoutePoints() */
+
+
+/**
+ *  @brief Route new points down the tree. KQ( i, j ) must return the 
+ *         similarity between the i-th new point and the j-th (gid) 
+ *         training point. For KERNEL_DISTANCE and ANGLE_DISTANCE, the
+ *         self-similarity of a new point is assumed to equal that of 
+ *         the pivots, which holds for stationary kernels (e.g. Gaussian).
+ *
+ *  @return queries[ treelist_id ] contains all new points in the node.
+ */ 
+template<typename TREE, typename KQMATRIX>
+vector<vector<size_t>> RouteNewPoints( TREE &tree, KQMATRIX &KQ )
+{
+  /** Derive type T from TREE. */
+  using T = typename TREE::T;
+  auto &K = *tree.setup.K;
+  auto metric = tree.setup.splitter.metric;
+
+  auto distances = [&] ( vector<size_t> &I, vector<size_t> &pivots )
+  {
+    if ( metric == GEOMETRY_DISTANCE ) return KQ.GeometryDistances( I, pivots );
+
+    Data<T> D = KQ( I, pivots );
+    auto DPP = K.Diagonal( pivots );
+    for ( size_t j = 0; j < D.col(); j ++ )
+    {
+      for ( size_t i = 0; i < D.row(); i ++ )
+      {
+        auto kij = D( i, j );
+        auto kjj = DPP[ j ];
+        if ( metric == KERNEL_DISTANCE ) D( i, j ) = 2.0 * ( kjj - kij );
+        else D( i, j ) = 1.0 - ( kij * kij ) / ( kjj * kjj );
+      }
+    }
+    return D;
+  };
+
+  return RoutePoints( tree, KQ.row(), distances );
+}; /** end RouteNewPoints() */
+
+
+/**
+ *  @brief Evaluate KQ * weights for a batch of new points using the
+ *         compressed tree. Each new point is routed to a leaf, where
+ *         NNNearNodes are evaluated directly. The far field of the leaf
+ *         and all its ancestors (NNFarNodes) is evaluated with the 
+ *         skeleton weights w_skel. This routine uses the current 
+ *         w_leaf and w_skel, i.e. Evaluate() or UpdateSkeletonWeights()
+ *         must have been called with the same weights.
+ *
+ *  @return KQ.row()-by-nrhs potentials.
+ */ 
+template<typename TREE, typename KQMATRIX>
+Data<typename TREE::T> OutOfSampleEvaluate( TREE &tree, KQMATRIX &KQ )
+{
+  /** Derive type T from TREE. */
+  using T = typename TREE::T;
+
+  double beg, route_time, evaluate_time;
+  /** All leaf nodes have w_leaf with nrhs columns. */
+  size_t nrhs = tree.treelist.back()->data.w_leaf.col();
+  Data<T> potentials( KQ.row(), nrhs, 0.0 );
+
+  /** Route all new points to leaf nodes. */
+  beg = omp_get_wtime();
+  auto queries = RouteNewPoints( tree, KQ );
+  route_time = omp_get_wtime() - beg;
+
+  /** 
+   *  Levels are processed in sequential. Nodes at the same level own 
+   *  disjoint new points; thus, they can be processed in parallel.
+   */
+  beg = omp_get_wtime();
+  for ( size_t l = 0; l <= tree.depth; l ++ )
+  {
+    int n_nodes = 1 << l;
+    auto level_beg = tree.treelist.begin() + n_nodes - 1;
+    #pragma omp parallel for schedule( dynamic )
+    for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+    {
+      auto *node = *(level_beg + node_ind);
+      auto &I = queries[ node->treelist_id ];
+      if ( !I.size() ) continue;
+
+      /** Far field: KQ( I, skels ) * w_skel. */
+      Data<T> uI( I.size(), nrhs, 0.0 );
+      for ( auto *it : node->NNFarNodes )
+      {
+        auto &w_skel = it->data.w_skel;
+        if ( !w_skel.size() ) continue;
+        auto KIJ = KQ( I, it->data.skels );
+        xgemm( "N", "N", uI.row(), uI.col(), w_skel.row(),
+          1.0,    KIJ.data(),    KIJ.row(),
+               w_skel.data(), w_skel.row(),
+          1.0,     uI.data(),     uI.row() );
+      }
+
+      /** Near field: KQ( I, gids ) * w_leaf. */
+      if ( node->isleaf )
+      {
+        for ( auto *it : node->NNNearNodes )
+        {
+          auto &w_leaf = it->data.w_leaf;
+          auto KIJ = KQ( I, it->gids );
+          xgemm( "N", "N", uI.row(), uI.col(), w_leaf.row(),
+            1.0,    KIJ.data(),    KIJ.row(),
+                 w_leaf.data(), w_leaf.row(),
+            1.0,     uI.data(),     uI.row() );
+        }
+      }
+
+      /** Accumulate to potentials. */
+      for ( size_t j = 0; j < nrhs; j ++ )
+        for ( size_t i = 0; i < I.size(); i ++ )
+          potentials( I[ i ], j ) += uI( i, j );
+    }
+  }
+  evaluate_time = omp_get_wtime() - beg;
+
+  if ( REPORT_EVALUATE_STATUS )
+  {
+    printf( "========================================================\n");
+    printf( "GOFMM out-of-sample evaluation (%lu new points)\n", KQ.row() );
+    printf( "========================================================\n");
+    printf( "Route ---------------------------------- %5.2lfs\n", route_time );
+    printf( "Near and far -------------------------- %5.2lfs\n", evaluate_time );
+    printf( "========================================================\n\n");
+  }
+
+  return potentials;
+}; /** end OutOfSampleEvaluate() */
+
+
+/** @brief Update w_skel with weights, then evaluate KQ * weights. */
+template<typename TREE, typename KQMATRIX, typename T>
+Data<T> OutOfSampleEvaluate( TREE &tree, KQMATRIX &KQ, Data<T> &weights )
+{
+  UpdateSkeletonWeights( tree, weights );
+  return OutOfSampleEvaluate( tree, KQ );
+}; /** end OutOfSampleEvaluate() */
+
+/**
+ *  @brief Rebuild NNNearNodes of dirty leaves while keeping all near
+ *         lists symmetric. NNNearNodeMortonIDs of a leaf only holds its
+ *         own selection, so a back-reference to a dirty leaf L is kept
+ *         only if the neighbor itself selected L.
+ *
+ *  @return near_changed[ treelist_id ] marks leaves whose lists changed.
+ */ 
+template<typename TREE, typename NODE>
+vector<bool> UpdateNearNodes( TREE &tree, vector<NODE*> &dirty_leafs, 
+    vector<bool> &dirty )
+{
+  using T = typename TREE::T;
+  vector<bool> near_changed( tree.treelist.size(), false );
+  vector<set<NODE*>> old_near( dirty_leafs.size() );
+
+  /** Drop back-references to dirty leaves that were not selected. */
+  for ( size_t i = 0; i < dirty_leafs.size(); i ++ )
+  {
+    auto *leaf = dirty_leafs[ i ];
+    near_changed[ leaf->treelist_id ] = true;
+    old_near[ i ] = leaf->NNNearNodes;
+    for ( auto *it : old_near[ i ] )
+    {
+      if ( it == leaf || dirty[ it->treelist_id ] ) continue;
+      if ( it->NNNearNodeMortonIDs.count( leaf->morton ) ) continue;
+      it->NNNearNodes.erase( leaf );
+      near_changed[ it->treelist_id ] = true;
+    }
+  }
+
+  /** Rebuild the selection of dirty leaves. */
+  #pragma omp parallel for schedule( dynamic )
+  for ( size_t i = 0; i < dirty_leafs.size(); i ++ )
+  {
+    auto *leaf = dirty_leafs[ i ];
+    leaf->NearNodes.clear();
+    leaf->NNNearNodes.clear();
+    leaf->NNNearNodeMortonIDs.clear();
+    NearSamples<NODE, T>( leaf );
+  }
+
+  /** Symmetrize only the lists that involve dirty leaves. */
+  for ( size_t i = 0; i < dirty_leafs.size(); i ++ )
+  {
+    auto *leaf = dirty_leafs[ i ];
+    /** Clean leaves that selected me are still my neighbors. */
+    for ( auto *it : old_near[ i ] )
+    {
+      if ( it == leaf || dirty[ it->treelist_id ] ) continue;
+      if ( it->NNNearNodeMortonIDs.count( leaf->morton ) ) 
+        leaf->NNNearNodes.insert( it );
+    }
+    /** Leaves I selected must see me. */
+    for ( auto morton : leaf->NNNearNodeMortonIDs )
+    {
+      auto *target = tree.morton2node[ morton ];
+      if ( target->NNNearNodes.insert( leaf ).second ) 
+        near_changed[ target->treelist_id ] = true;
+    }
+  }
+
+  return near_changed;
+}; /** end UpdateNearNodes() */
+
+
+/**
+ *  @brief Rebuild NNFarNodes of leaves whose near lists changed and of 
+ *         their ancestors, following the same rules as MergeFarNodes():
+ *
+ *         raw( leaf ) = FindFarNodes( root, leaf ),
+ *         raw( node ) = raw( lchild ) intersects raw( rchild ),
+ *         own( node ) = raw( node ) \ raw( parent ).
+ *
+ *         Nodes without skeletons have an empty raw list. For symmetric
+ *         matrices the list of a node is own( node ) plus the back 
+ *         references { x : node in own( x ) }, and own entries are 
+ *         exactly those with larger MortonIDs. raw( node ) of an
+ *         untouched node is recovered as own( node ) plus raw( parent ).
+ *         Only the touched nodes and their siblings are visited.
+ *
+ *  @return far_changed[ treelist_id ] marks nodes whose lists changed.
+ */ 
+template<typename TREE>
+vector<bool> UpdateFarNodes( TREE &tree, vector<bool> &near_changed )
+{
+  using NODE = typename TREE::NODE;
+  bool is_symmetric = tree.setup.IsSymmetric();
+  size_t n_nodes = tree.treelist.size();
+  vector<bool> far_changed( n_nodes, false );
+  auto *root = tree.treelist[ 0 ];
+
+  /** Touched nodes: leaves with new near lists and all their ancestors. */
+  vector<bool> touched( n_nodes, false );
+  for ( int i = n_nodes - 1; i >= 0; i -- )
+  {
+    auto *node = tree.treelist[ i ];
+    if ( node->isleaf ) touched[ i ] = near_changed[ i ];
+    else touched[ i ] = touched[ node->lchild->treelist_id ] 
+                     || touched[ node->rchild->treelist_id ];
+  }
+
+  auto Own = [&] ( NODE *node )
+  {
+    set<NODE*> own;
+    for ( auto *it : node->NNFarNodes )
+      if ( !is_symmetric || it->morton > node->morton ) own.insert( it );
+    return own;
+  };
+
+  /** Old raw lists of touched nodes (top-down). */
+  map<NODE*, set<NODE*>> raw_old, raw_new;
+  for ( size_t i = 0; i < n_nodes; i ++ )
+  {
+    if ( !touched[ i ] ) continue;
+    auto *node = tree.treelist[ i ];
+    raw_old[ node ] = Own( node );
+    if ( node->parent && node->parent->data.isskel )
+    {
+      auto &praw = raw_old[ node->parent ];
+      raw_old[ node ].insert( praw.begin(), praw.end() );
+    }
+  }
+
+  /** Raw list of a child of a touched node. */
+  auto RawOf = [&] ( NODE *child )
+  {
+    if ( touched[ child->treelist_id ] ) return raw_new[ child ];
+    set<NODE*> raw;
+    if ( !child->data.isskel ) return raw;
+    raw = Own( child );
+    if ( child->parent->data.isskel )
+    {
+      auto &praw = raw_old[ child->parent ];
+      raw.insert( praw.begin(), praw.end() );
+    }
+    return raw;
+  };
+
+  /** New raw lists of touched nodes (bottom-up). */
+  for ( int i = n_nodes - 1; i >= 0; i -- )
+  {
+    if ( !touched[ i ] ) continue;
+    auto *node = tree.treelist[ i ];
+    auto &raw = raw_new[ node ];
+    if ( !node->data.isskel ) continue;
+    if ( node->isleaf )
+    {
+      /** FindFarNodes() inserts into both lists; keep the current ones. */
+      auto FarNodes = node->FarNodes;
+      auto NNFarNodes = node->NNFarNodes;
+      node->NNFarNodes.clear();
+      FindFarNodes( root, node );
+      raw = node->NNFarNodes;
+      node->FarNodes = FarNodes;
+      node->NNFarNodes = NNFarNodes;
+    }
+    else
+    {
+      auto lraw = RawOf( node->lchild );
+      auto rraw = RawOf( node->rchild );
+      for ( auto *it : lraw ) if ( rraw.count( it ) ) raw.insert( it );
+    }
+  }
+
+  /** Replace own( node ) and update back references. */
+  auto Replace = [&] ( NODE *node, set<NODE*> &own_new )
+  {
+    auto own_old = Own( node );
+    for ( auto *it : own_old )
+    {
+      if ( own_new.count( it ) ) continue;
+      node->NNFarNodes.erase( it );
+      far_changed[ node->treelist_id ] = true;
+      if ( !is_symmetric ) continue;
+      it->NNFarNodes.erase( node );
+      far_changed[ it->treelist_id ] = true;
+    }
+    for ( auto *it : own_new )
+    {
+      if ( own_old.count( it ) ) continue;
+      node->NNFarNodes.insert( it );
+      far_changed[ node->treelist_id ] = true;
+      if ( !is_symmetric ) continue;
+      it->NNFarNodes.insert( node );
+      far_changed[ it->treelist_id ] = true;
+    }
+  };
+
+  for ( size_t i = 0; i < n_nodes; i ++ )
+  {
+    if ( !touched[ i ] ) continue;
+    auto *node = tree.treelist[ i ];
+    set<NODE*> empty;
+    auto &praw = ( node->parent && node->parent->data.isskel ) 
+      ? raw_new[ node->parent ] : empty;
+    /** own( node ) = raw( node ) \ raw( parent ). */
+    set<NODE*> own_new;
+    for ( auto *it : raw_new[ node ] ) if ( !praw.count( it ) ) own_new.insert( it );
+    Replace( node, own_new );
+    /** raw( parent ) of untouched children may have changed. */
+    if ( node->isleaf ) continue;
+    for ( auto *child : { node->lchild, node->rchild } )
+    {
+      if ( touched[ child->treelist_id ] || !child->data.isskel ) continue;
+      auto raw = RawOf( child );
+      auto &nraw = node->data.isskel ? raw_new[ node ] : empty;
+      set<NODE*> child_own;
+      for ( auto *it : raw ) if ( !nraw.count( it ) ) child_own.insert( it );
+      Replace( child, child_own );
+    }
+  }
+
+  return far_changed;
+}; /** end UpdateFarNodes() */
+
+
+/**
+ *  @brief Insert and remove points (gids) of a compressed tree without
+ *         recompressing from scratch. K must already be able to evaluate 
+ *         all inserted gids ( gid < K.col() ). Removed gids are simply 
+ *         excluded from the tree and receive zero potentials. Gids that
+ *         are already in the tree are skipped.
+ *
+ *         1) Inserted points are routed to leaves with the recorded 
+ *            splitter decisions, and removed points are erased from 
+ *            their leaves. These leaves are marked dirty.
+ *         2) If the two children of an ancestor become unbalanced by
+ *            more than a factor of two, the subtree is re-split locally.
+ *         3) Removed gids are dropped from the neighbor lists of nearby
+ *            points, and neighbors of points in dirty leaves are 
+ *            refreshed within their near interaction lists.
+ *         4) Dirty leaves and all their ancestors are re-skeletonized
+ *            (isskel is reset), while clean nodes keep their skeletons.
+ *         5) Near and far lists are updated only for dirty leaves, the
+ *            leaves whose near lists change, and their ancestors (see
+ *            UpdateNearNodes() and UpdateFarNodes()). Kab blocks are
+ *            cached again only for dirty nodes and changed lists.
+ *
+ *         The cost is proportional to the number of dirty nodes. Each
+ *         dirty leaf dirties its O( depth ) ancestors, so updates that 
+ *         are scattered over many leaves approach the cost of Compress()
+ *         (a warning is printed once more than half of the leaves are
+ *         dirty). The tree depth is fixed, so Compress() should also be 
+ *         preferred once the problem size changes significantly. 
+ *         Factorize() needs to be called again if the tree was factorized.
+ */ 
+template<typename TREE>
+void UpdatePoints( TREE &tree, vector<size_t> &inserted, vector<size_t> &removed )
+{
+  /** Derive type NODE and T from TREE. */
+  using NODE = typename TREE::NODE;
+  using T    = typename TREE::T;
+  /** options */
+  const bool NNPRUNE = true;
+
+  auto &setup = tree.setup;
+  auto &K = *setup.K;
+  auto &NN = *setup.NN;
+  auto metric = setup.MetricType();
+  size_t kappa = NN.row();
+  size_t N = K.col();
+
+  /** all timers */
+  double beg, route_time, neighbor_time, skel_time, list_time, cache_time;
+
+  /** dirty[ treelist_id ] marks nodes that need to be re-skeletonized. */
+  vector<bool> dirty( tree.treelist.size(), false );
+  int n_leafs = ( 1 << tree.depth );
+  auto leaf_beg = tree.treelist.begin() + n_leafs - 1;
+
+  /** Per-point tables must be accessible with all gids of K. */
+  pair<T, size_t> init( numeric_limits<T>::max(), N );
+  if ( setup.morton.size() < N ) setup.morton.resize( N, 0 );
+  if ( NN.col() < N ) NN.resize( kappa, N, init );
+
+  /** Returns the leaf that owns gid (NULL if gid is not in the tree). */
+  auto Owner = [&] ( size_t gid ) -> NODE*
+  {
+    auto it = tree.morton2node.find( setup.morton[ gid ] );
+    if ( it == tree.morton2node.end() || !it->second->isleaf ) return NULL;
+    auto &gids = it->second->gids;
+    if ( find( gids.begin(), gids.end(), gid ) == gids.end() ) return NULL;
+    return it->second;
+  };
+
+  /** Remove points from their leaves. */
+  beg = omp_get_wtime();
+  set<size_t> removed_gids;
+  set<NODE*> shrunk_leafs;
+  for ( auto gid : removed )
+  {
+    auto *leaf = Owner( gid );
+    if ( !leaf ) continue;
+    auto &gids = leaf->gids;
+    gids.erase( find( gids.begin(), gids.end(), gid ) );
+    removed_gids.insert( gid );
+    shrunk_leafs.insert( leaf );
+    dirty[ leaf->treelist_id ] = true;
+  }
+
+  /** Skip gids that are already in the tree or repeated. */
+  vector<size_t> new_gids;
+  set<size_t> seen;
+  for ( auto gid : inserted )
+  {
+    assert( gid < N );
+    if ( Owner( gid ) || !seen.insert( gid ).second )
+    {
+      printf( "UpdatePoints(): gid %lu is already in the tree\n", gid );
+      continue;
+    }
+    new_gids.push_back( gid );
+  }
+
+  /** Route inserted points to leaves with the splitter metric. */
+  auto distances = [&] ( vector<size_t> &I, vector<size_t> &pivots )
+  {
+    vector<size_t> Igids( I.size() );
+    for ( size_t i = 0; i < I.size(); i ++ ) Igids[ i ] = new_gids[ I[ i ] ];
+    return K.Distances( setup.splitter.metric, Igids, pivots );
+  };
+  auto queries = RoutePoints( tree, new_gids.size(), distances );
+  for ( int node_ind = 0; node_ind < n_leafs; node_ind ++ )
+  {
+    auto *leaf = *(leaf_beg + node_ind);
+    for ( auto i : queries[ leaf->treelist_id ] )
+    {
+      leaf->gids.push_back( new_gids[ i ] );
+      setup.morton[ new_gids[ i ] ] = leaf->morton;
+      dirty[ leaf->treelist_id ] = true;
+    }
+  }
+
+  /** Count the number of points in each subtree (bottom-up). */
+  vector<size_t> subtree_size( tree.treelist.size(), 0 );
+  for ( int i = tree.treelist.size() - 1; i >= 0; i -- )
+  {
+    auto *node = tree.treelist[ i ];
+    if ( node->isleaf ) subtree_size[ i ] = node->gids.size();
+    else subtree_size[ i ] = subtree_size[ node->lchild->treelist_id ] 
+                           + subtree_size[ node->rchild->treelist_id ];
+  }
+
+  /** Find the highest unbalanced ancestor of each dirty leaf. */
+  set<NODE*> resplit;
+  for ( int node_ind = 0; node_ind < n_leafs; node_ind ++ )
+  {
+    auto *leaf = *(leaf_beg + node_ind);
+    if ( !dirty[ leaf->treelist_id ] ) continue;
+    NODE *highest = NULL;
+    for ( auto *node = leaf->parent; node; node = node->parent )
+    {
+      size_t nl = subtree_size[ node->lchild->treelist_id ];
+      size_t nr = subtree_size[ node->rchild->treelist_id ];
+      if ( nl > 2 * nr + 1 || nr > 2 * nl + 1 ) highest = node;
+    }
+    if ( highest ) resplit.insert( highest );
+  }
+
+  /** Re-split unbalanced subtrees top-down (outermost first). */
+  vector<bool> visited( tree.treelist.size(), false );
+  vector<NODE*> resplit_list( resplit.begin(), resplit.end() );
+  sort( resplit_list.begin(), resplit_list.end(), 
+      [] ( NODE *a, NODE *b ) { return a->l < b->l; } );
+  for ( auto *root : resplit_list )
+  {
+    if ( visited[ root->treelist_id ] ) continue;
+    /** Collect all gids of the subtree from its leaves. */
+    vector<NODE*> subtree( 1, root );
+    root->gids.clear();
+    for ( size_t i = 0; i < subtree.size(); i ++ )
+    {
+      auto *node = subtree[ i ];
+      if ( node->isleaf ) 
+        root->gids.insert( root->gids.end(), node->gids.begin(), node->gids.end() );
+      else
+      {
+        subtree.push_back( node->lchild );
+        subtree.push_back( node->rchild );
+      }
+    }
+    root->n = root->gids.size();
+    /** Split in the BFS order and update MortonIDs of all points. */
+    for ( auto *node : subtree )
+    {
+      visited[ node->treelist_id ] = true;
+      dirty[ node->treelist_id ] = true;
+      node->Split();
+      if ( node->isleaf )
+        for ( auto gid : node->gids ) setup.morton[ gid ] = node->morton;
+    }
+  }
+
+  /** All ancestors of dirty nodes are dirty; update their gids. */
+  for ( int i = tree.treelist.size() - 1; i >= 0; i -- )
+  {
+    auto *node = tree.treelist[ i ];
+    if ( !node->isleaf )
+    {
+      if ( dirty[ node->lchild->treelist_id ] || 
+           dirty[ node->rchild->treelist_id ] ) dirty[ i ] = true;
+      if ( dirty[ i ] )
+      {
+        node->gids = node->lchild->gids;
+        node->gids.insert( node->gids.end(), 
+            node->rchild->gids.begin(), node->rchild->gids.end() );
+      }
+    }
+    node->n = node->gids.size();
+  }
+  tree.n = tree.treelist[ 0 ]->n;
+  tree.Offset( tree.treelist[ 0 ], 0 );
+  route_time = omp_get_wtime() - beg;
+
+  vector<NODE*> dirty_leafs;
+  for ( int node_ind = 0; node_ind < n_leafs; node_ind ++ )
+  {
+    auto *leaf = *(leaf_beg + node_ind);
+    if ( dirty[ leaf->treelist_id ] ) dirty_leafs.push_back( leaf );
+  }
+
+  /** 
+   *  Points whose neighbors were removed live in the shrunk leaves or
+   *  in their near nodes. Mark those neighbors as missing such that they
+   *  no longer vote in NearNodeBallots().
+   */
+  beg = omp_get_wtime();
+  map<NODE*, vector<size_t>> refresh;
+  for ( auto *leaf : dirty_leafs ) refresh[ leaf ] = leaf->gids;
+  set<NODE*> scrub_leafs;
+  for ( auto *leaf : shrunk_leafs )
+    scrub_leafs.insert( leaf->NNNearNodes.begin(), leaf->NNNearNodes.end() );
+  for ( auto *leaf : scrub_leafs )
+  {
+    if ( dirty[ leaf->treelist_id ] ) continue;
+    for ( auto gid : leaf->gids )
+    {
+      bool has_removed = false;
+      for ( size_t i = 0; i < kappa; i ++ )
+      {
+        if ( !removed_gids.count( NN( i, gid ).second ) ) continue;
+        NN( i, gid ) = init;
+        has_removed = true;
+      }
+      if ( has_removed ) refresh[ leaf ].push_back( gid );
+    }
+  }
+
+  /** Refresh neighbors within near interaction lists. */
+  vector<pair<NODE*, vector<size_t>>> refresh_list( refresh.begin(), refresh.end() );
+  #pragma omp parallel for schedule( dynamic )
+  for ( size_t i = 0; i < refresh_list.size(); i ++ )
+  {
+    auto *leaf = refresh_list[ i ].first;
+    auto &I = refresh_list[ i ].second;
+    /** Search among the leaf itself and its near nodes. */
+    vector<size_t> R = leaf->gids;
+    for ( auto *near : leaf->NNNearNodes )
+      if ( near != leaf ) R.insert( R.end(), near->gids.begin(), near->gids.end() );
+    if ( !I.size() || R.size() < kappa ) continue;
+    auto candidates = K.NeighborSearch( metric, kappa, I, R, init );
+    vector<pair<T, size_t>> aux( 2 * kappa );
+    for ( size_t j = 0; j < I.size(); j ++ )
+    {
+      MergeNeighbors( kappa, NN.columndata( I[ j ] ), 
+          candidates.columndata( j ), aux );
+    }
+  }
+  neighbor_time = omp_get_wtime() - beg;
+
+  /** Re-skeletonize dirty nodes level-by-level (bottom-up, except root). */
+  beg = omp_get_wtime();
+  vector<bool> was_skel( tree.treelist.size() );
+  for ( auto *node : tree.treelist ) 
+    was_skel[ node->treelist_id ] = node->data.isskel;
+  for ( int l = tree.depth; l >= 1; l -- )
+  {
+    int n_nodes = 1 << l;
+    auto level_beg = tree.treelist.begin() + n_nodes - 1;
+    #pragma omp parallel for schedule( dynamic )
+    for ( int node_ind = 0; node_ind < n_nodes; node_ind ++ )
+    {
+      auto *node = *(level_beg + node_ind);
+      if ( !dirty[ node->treelist_id ] ) continue;
+      node->data.isskel = false;
+      SkeletonKIJ( node );
+      Skeletonize( node );
+      Interpolate( node );
+    }
+  }
+  bool has_new_skel = false;
+  for ( auto *node : tree.treelist )
+    if ( was_skel[ node->treelist_id ] != node->data.isskel ) has_new_skel = true;
+  skel_time = omp_get_wtime() - beg;
+
+  /** Update near lists of dirty leaves and keep them symmetric. */
+  beg = omp_get_wtime();
+  auto near_changed = UpdateNearNodes( tree, dirty_leafs, dirty );
+
+  /** Update far lists (rebuild all if some node gains or loses skeletons). */
+  vector<bool> far_changed( tree.treelist.size(), true );
+  if ( has_new_skel )
+  {
+    for ( auto *node : tree.treelist )
+    {
+      node->FarNodes.clear();
+      node->NNFarNodes.clear();
+    }
+    MergeFarNodes( tree );
+  }
+  else far_changed = UpdateFarNodes( tree, near_changed );
+  list_time = omp_get_wtime() - beg;
+
+  /** Kab must be cached again if the list changed or has dirty nodes. */
+  beg = omp_get_wtime();
+  vector<bool> near_stale = near_changed, far_stale = far_changed;
+  for ( auto *node : tree.treelist )
+  {
+    auto i = node->treelist_id;
+    if ( !dirty[ i ] ) continue;
+    near_stale[ i ] = far_stale[ i ] = true;
+    /** Near and far lists are symmetric (back references). */
+    for ( auto *it : node->NNNearNodes ) near_stale[ it->treelist_id ] = true;
+    if ( setup.IsSymmetric() )
+      for ( auto *it : node->NNFarNodes ) far_stale[ it->treelist_id ] = true;
+  }
+  if ( !setup.IsSymmetric() )
+  {
+    for ( auto *node : tree.treelist )
+      for ( auto *it : node->NNFarNodes )
+        if ( dirty[ it->treelist_id ] ) far_stale[ node->treelist_id ] = true;
+  }
+
+  /** Cache Kab only for stale lists. */
+  size_t n_near_cached = 0, n_far_cached = 0;
+  #pragma omp parallel for schedule( dynamic ) reduction( +:n_near_cached,n_far_cached )
+  for ( size_t i = 0; i < tree.treelist.size(); i ++ )
+  {
+    auto *node = tree.treelist[ i ];
+    if ( node->isleaf && near_stale[ i ] )
+    {
+      node->data.w_leaf.reserve( node->gids.size(), MAX_NRHS );
+      node->data.u_leaf[ 0 ].reserve( MAX_NRHS, node->gids.size() );
+      CacheNearNodes<NNPRUNE>( node );
+      n_near_cached ++;
+    }
+    if ( far_stale[ i ] )
+    {
+      CacheFarNodes<NNPRUNE>( node );
+      n_far_cached ++;
+    }
+  }
+  cache_time = omp_get_wtime() - beg;
+
+  /** Clean up all r/w dependencies left on tree nodes. */
+  tree.DependencyCleanUp();
+
+  if ( REPORT_COMPRESS_STATUS )
+  {
+    size_t n_dirty = 0;
+    for ( auto it : dirty ) n_dirty += it;
+    printf( "========================================================\n");
+    printf( "GOFMM update (+%lu -%lu points, %lu/%lu dirty nodes)\n", 
+        new_gids.size(), removed_gids.size(), n_dirty, tree.treelist.size() );
+    printf( "========================================================\n");
+    printf( "Routing and rebalancing --------------- %5.2lfs\n", route_time );
+    printf( "NeighborSearch ------------------------ %5.2lfs\n", neighbor_time );
+    printf( "Skeletonization ----------------------- %5.2lfs\n", skel_time );
+    printf( "Interaction lists --------------------- %5.2lfs\n", list_time );
+    printf( "Cache (near %4lu, far %4lu) ----------- %5.2lfs\n", 
+        n_near_cached, n_far_cached, cache_time );
+    printf( "========================================================\n");
+    if ( 2 * dirty_leafs.size() > n_leafs )
+      printf( "%lu/%d leaves are dirty; Compress() may be cheaper.\n", 
+          dirty_leafs.size(), n_leafs );
+    printf( "\n" );
+  }
+}; /** end UpdatePoints() */
+
+
+/** @brief Insert points (gids of K) into a compressed tree. */ 
+template<typename TREE>
+void InsertPoints( TREE &tree, vector<size_t> &inserted )
+{
+  vector<size_t> removed;
+  UpdatePoints( tree, inserted, removed );
+}; /** end InsertPoints() */
+
+
+/** @brief Remove points (gids of K) from a compressed tree. */ 
+template<typename TREE>
+void RemovePoints( TREE &tree, vector<size_t> &removed )
+{
+  vector<size_t> inserted;
+  UpdatePoints( tree, inserted, removed );
+}; /** end RemovePoints() */
+
+
+
+
 template<typename SPLITTER, typename T, typename SPDMATRIX>
 Data<pair<T, size_t>> FindNeighbors
 (
@@ -418,6 +418,13 @@ struct centersplit : public gofmm::centersplit<SPDMATRIX, N_SPLIT, T>
     return gofmm::centersplit<SPDMATRIX, N_SPLIT, T>::operator() ( gids );
   };
 
+  /** Shared-memory operator (also return the decision). */
+  inline vector<vector<size_t> > operator() ( vector<size_t>& gids,
+      vector<size_t> &pivots, T &median ) const 
+  {
+    return gofmm::centersplit<SPDMATRIX, N_SPLIT, T>::operator() ( gids, pivots, median );
+  };
+
   /** Distributed operator. */
   inline vector<vector<size_t> > operator() ( vector<size_t>& gids, mpi::Comm comm ) const 
   {
@@ -556,6 +563,13 @@ struct randomsplit : public gofmm::randomsplit<SPDMATRIX, N_SPLIT, T>
     return gofmm::randomsplit<SPDMATRIX, N_SPLIT, T>::operator() ( gids );
   };
 
+  /** Shared-memory operator (also return the decision). */
+  inline vector<vector<size_t> > operator() ( vector<size_t>& gids,
+      vector<size_t> &pivots, T &median ) const 
+  {
+    return gofmm::randomsplit<SPDMATRIX, N_SPLIT, T>::operator() ( gids, pivots, median );
+  };
+
   /** Distributed operator. */
   inline vector<vector<size_t> > operator() ( vector<size_t>& gids, mpi::Comm comm ) const 
   {
@@ -1366,7 +1380,7 @@ class L2LTask2 : public Task
       {
         /** Get W view of this treenode. (available for non-LET nodes) */
         View<T> &W = src->data.w_view;
-        Data<T> &w = src->data.w_leaf;
+        auto &w = src->data.w_leaf;
         
         bool is_cached = true;
         auto &J = src->gids;
@@ -3478,6 +3492,19 @@ class SkeletonizeTask : public hmlp::Task
       arg->data.skeletonize = event;
     };
 
+    /** Bound the candidate columns since children may not be skeletonized yet. */
+    double SizeHint()
+    {
+      size_t s = arg->setup->MaximumRank();
+      size_t n = arg->gids.size();
+      if ( !arg->isleaf ) n = std::min( n, 2 * s );
+      size_t m = 2 * n;
+      size_t k = std::min( n, s );
+      /** GEQP3 (flops and mops) and TRSM as in GetEventRecord(). */
+      return 2.0 * n * n * ( 3 * m - n ) 
+        + k * ( k - 1 ) * ( n + 1 ) + 2.0 * ( k * k + k * n );
+    };
+
     void DependencyAnalysis()
     {
       arg->DependencyAnalysis( RW, this );
@@ -3559,6 +3586,21 @@ class DistSkeletonizeTask : public hmlp::Task
       arg->data.skeletonize = event;
     };
 
+    /** Bound the candidate columns since children may not be skeletonized yet. */
+    double SizeHint()
+    {
+      /** Only the root rank of the communicator skeletonizes. */
+      if ( arg->GetCommRank() ) return 0.0;
+      size_t s = arg->setup->MaximumRank();
+      size_t n = arg->gids.size();
+      if ( !arg->isleaf ) n = std::min( n, 2 * s );
+      size_t m = 2 * n;
+      size_t k = std::min( n, s );
+      /** GEQP3 (flops and mops) and TRSM as in GetEventRecord(). */
+      return 2.0 * n * n * ( 3 * m - n ) 
+        + k * ( k - 1 ) * ( n + 1 ) + 2.0 * ( k * k + k * n );
+    };
+
     void DependencyAnalysis()
     {
       arg->DependencyAnalysis( RW, this );
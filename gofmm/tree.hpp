@@ -588,6 +588,33 @@ class SplitTask : public Task
 //};
 
 
+/**
+ *  @brief Split gids and record the decision if the splitter supports
+ *         operator()( gids, pivots, median ).
+ */ 
+template<typename SPLITTER, typename T>
+auto SplitAndRecord( SPLITTER &splitter, vector<size_t> &gids, 
+    vector<size_t> &pivots, T &median, int )
+  -> decltype( splitter( gids, pivots, median ) )
+{
+  return splitter( gids, pivots, median );
+}; /** end SplitAndRecord() */
+
+
+/**
+ *  @brief User-defined splitters may only provide operator()( gids ).
+ *         Leave pivots empty such that the split cannot be replayed.
+ */ 
+template<typename SPLITTER, typename T>
+auto SplitAndRecord( SPLITTER &splitter, vector<size_t> &gids, 
+    vector<size_t> &pivots, T &median, long )
+  -> decltype( splitter( gids ) )
+{
+  pivots.clear();
+  return splitter( gids );
+}; /** end SplitAndRecord() */
+
+
 /**
  *  @brief 
  */ 
@@ -664,7 +691,7 @@ class Node : public ReadWrite
       int max_depth = setup->max_depth;
 
       double beg = omp_get_wtime();
-      auto split = setup->splitter( gids );
+      auto split = SplitAndRecord( setup->splitter, gids, split_pivots, split_median, 0 );
       double splitter_time = omp_get_wtime() - beg;
       //printf( "splitter %5.3lfs\n", splitter_time );
 
@@ -678,6 +705,8 @@ class Node : public ReadWrite
         }
         //printf( "split[ 0 ].size() %lu split[ 1 ].size() %lu\n", 
         //  split[ 0 ].size(), split[ 1 ].size() );
+        /** The recorded decision no longer describes this split. */
+        split_pivots.clear();
         split[ 0 ].resize( gids.size() / 2 );
         split[ 1 ].resize( gids.size() - ( gids.size() / 2 ) );
         //#pragma omp parallel for
@@ -807,6 +836,15 @@ class Node : public ReadWrite
 
     vector<size_t> gids;
 
+    /** 
+     *  Splitter decision: gids of the two pivots and the median of
+     *  d( x, pivot[ 0 ] ) - d( x, pivot[ 1 ] ). A point x goes to
+     *  lchild if its value is less than split_median. An empty
+     *  split_pivots means the decision cannot be replayed.
+     */
+    vector<size_t> split_pivots;
+    T split_median = 0;
+
     /** These two prunning lists are used when no NN pruning. */
     set<size_t> FarIDs;
     set<Node*>  FarNodes;
@@ -861,6 +899,25 @@ class Node : public ReadWrite
 }; /** end class Node */
 
 
+/**
+ *  @brief Tasks on a node stay on the socket that owns its subtree. The
+ *         treelist is a complete binary tree in breadth-first order, so
+ *         a node at (local) level l with index i splits its level into
+ *         n_socket contiguous blocks. Nodes above the socket level 
+ *         (2^l < n_socket) can run anywhere.
+ */ 
+template<typename SETUP, typename NODEDATA>
+int TaskAffinity( Node<SETUP, NODEDATA> *node )
+{
+  int n_socket = hmlp_get_num_socket();
+  if ( n_socket < 2 ) return -1;
+  size_t id = node->treelist_id + 1, width = 1;
+  while ( 2 * width <= id ) width *= 2;
+  if ( width < n_socket ) return -1;
+  return ( ( id - width ) * n_socket ) / width;
+}; /** end TaskAffinity() */
+
+
 /**
  *  @brief Data and setup that are shared with all nodes.
  *
@@ -46,6 +46,22 @@ typedef enum
   HMLP_OP_T
 } hmlpOperation_t;
 
+/** Image layouts of conv2d (N: batch, H: height, W: width, C: channels). */
+typedef enum
+{
+  HMLP_NHWC,
+  HMLP_NCHW
+} hmlpLayout_t;
+
+/** Convolution algorithms (Winograd only applies to 3x3 stride-1 filters). */
+typedef enum
+{
+  HMLP_CONV_AUTO,
+  HMLP_CONV_IM2COL,
+  HMLP_CONV_WINOGRAD_F2X2,
+  HMLP_CONV_WINOGRAD_F4X4
+} hmlpConvAlgorithm_t;
+
 
 void gkmx_sfma
 (
@@ -86,6 +102,14 @@ void gkmx_dconv_relu_pool
   double *C, int ldc
 );
 
+void sstrassen(
+  hmlpOperation_t transA, hmlpOperation_t transB,
+  int m, int n, int k,
+  float *A, int lda,
+  float *B, int ldb,
+  float *C, int ldc
+);
+
 void dstrassen(
   hmlpOperation_t transA, hmlpOperation_t transB,
   int m, int n, int k,
@@ -130,6 +154,68 @@ void dconv2d_ref
 	double *C
 );
 
+/** NHWC images with OHWI filters, or NCHW images with OIHW filters. */
+void sconv2d
+(
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B,
+  int w1, int h1, int d1,
+	float *A,
+	float *C
+);
+
+void dconv2d
+(
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  double *B,
+  int w1, int h1, int d1,
+	double *A,
+	double *C
+);
+
+/** HMLP_CONV_AUTO selects the algorithm by filter size and stride. */
+void sconv2d
+(
+  hmlpConvAlgorithm_t algorithm, hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B,
+  int w1, int h1, int d1,
+	float *A,
+	float *C
+);
+
+void dconv2d
+(
+  hmlpConvAlgorithm_t algorithm, hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  double *B,
+  int w1, int h1, int d1,
+	double *A,
+	double *C
+);
+
+void sconv2d_ref
+(
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B,
+  int w1, int h1, int d1,
+	float *A,
+	float *C
+);
+
+void dconv2d_ref
+(
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  double *B,
+  int w1, int h1, int d1,
+	double *A,
+	double *C
+);
+
 
 
 
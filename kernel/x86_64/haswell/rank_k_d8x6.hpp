@@ -17,10 +17,29 @@ struct rank_k_asm_s16x6
   const static size_t align_size = 32;
   const static bool   row_major  = false;
 
+  /** c_list[ t ] += alpha_list[ t ] * a * b for t < len */
   inline STRA_OPERATOR(float) const
   {
-    printf( "no STRA_OPERATOR implementation\n" );
-    exit( 1 );
+    float one = 1.0;
+
+    /** With one target, update it in place. */
+    if ( len == 1 )
+    {
+      bli_sgemm_asm_16x6( k, alpha_list, a, b, &one, c_list[ 0 ], 1, ldc, aux );
+      return;
+    }
+
+    /** Otherwise compute the product once and scatter it. */
+    float zero = 0.0;
+    float ctmp[ mr * nr ] __attribute__((aligned(32)));
+    bli_sgemm_asm_16x6( k, &one, a, b, &zero, ctmp, 1, mr, aux );
+    for ( int t = 0; t < len; t ++ )
+    {
+      float *c = c_list[ t ], alpha = alpha_list[ t ];
+      for ( size_t j = 0; j < nr; j ++ )
+        for ( size_t i = 0; i < mr; i ++ )
+          c[ j * ldc + i ] += alpha * ctmp[ j * mr + i ];
+    }
   };
 
   inline GEMM_OPERATOR(float) const
@@ -102,10 +121,29 @@ struct rank_k_asm_d8x6
   const static size_t align_size = 32;
   const static bool   row_major  = false;
 
+  /** c_list[ t ] += alpha_list[ t ] * a * b for t < len */
   inline STRA_OPERATOR(double) const
   {
-    printf( "no STRA_OPERATOR implementation\n" );
-    exit( 1 );
+    double one = 1.0;
+
+    /** With one target, update it in place. */
+    if ( len == 1 )
+    {
+      bli_dgemm_asm_8x6( k, alpha_list, a, b, &one, c_list[ 0 ], 1, ldc, aux );
+      return;
+    }
+
+    /** Otherwise compute the product once and scatter it. */
+    double zero = 0.0;
+    double ctmp[ mr * nr ] __attribute__((aligned(32)));
+    bli_dgemm_asm_8x6( k, &one, a, b, &zero, ctmp, 1, mr, aux );
+    for ( int t = 0; t < len; t ++ )
+    {
+      double *c = c_list[ t ], alpha = alpha_list[ t ];
+      for ( size_t j = 0; j < nr; j ++ )
+        for ( size_t i = 0; i < mr; i ++ )
+          c[ j * ldc + i ] += alpha * ctmp[ j * mr + i ];
+    }
   };
 
   inline GEMM_OPERATOR(double) const
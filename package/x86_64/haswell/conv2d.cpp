@@ -22,6 +22,10 @@
 
 /** CONV2D templates */
 #include <primitives/conv2d.hpp>
+/** Winograd transforms */
+#include <primitives/winograd.hpp>
+/** GEMM templates (for the Winograd tiles) */
+#include <primitives/gkmx.hpp>
 
 /** Haswell kernels */
 #include <rank_k_d8x6.hpp>
@@ -29,22 +33,103 @@
 using namespace hmlp::cnn;
 
 
+/** @brief C = A * B (column-major) on the micro-kernels of this package. */
+struct winograd_gemm
+{
+  void operator()
+  (
+    int m, int n, int k, 
+    float *A, int lda, float *B, int ldb, float *C, int ldc 
+  ) const
+  {
+    rank_k_asm_s16x6 semiringkernel;
+    rank_k_asm_s16x6 microkernel;
+
+    gkmx::gkmx<
+      144, 2040, 256, 16, 6,
+      144, 2040,      16, 6, 32,
+      false, true,
+      rank_k_asm_s16x6,
+      rank_k_asm_s16x6,
+      float, float, float, float>
+    (
+      HMLP_OP_N, HMLP_OP_N,
+      m, n, k,
+      A, lda,
+      B, ldb,
+      C, ldc,
+      0, // batchId
+      semiringkernel,
+      microkernel
+    );
+  };
+
+  void operator()
+  (
+    int m, int n, int k, 
+    double *A, int lda, double *B, int ldb, double *C, int ldc 
+  ) const
+  {
+    rank_k_asm_d8x6 semiringkernel;
+    rank_k_asm_d8x6 microkernel;
+
+    gkmx::gkmx<
+      72, 960, 256, 8, 6,
+      72, 960,      8, 6, 32,
+      false, true,
+      rank_k_asm_d8x6,
+      rank_k_asm_d8x6,
+      double, double, double, double>
+    (
+      HMLP_OP_N, HMLP_OP_N,
+      m, n, k,
+      A, lda,
+      B, ldb,
+      C, ldc,
+      0, // batchId
+      semiringkernel,
+      microkernel
+    );
+  };
+}; /** end struct winograd_gemm */
+
+
 
 void conv2d
 (
+  hmlpLayout_t layout,
   int w0, int h0, int d0, int s, int p, int batchSize,
   float *B, int w1, int h1, int d1,
 	float *A,
 	float *C
 )
 {
-  printf( "not implemented yet\n" );
-  exit( 1 );
+  rank_k_asm_s16x6 semiringkernel;
+  rank_k_asm_s16x6 microkernel;
+
+  conv2d<
+    144, 2040, 256, 16, 6, 
+    144, 2040,      16, 6, 32,
+    false,
+    rank_k_asm_s16x6, 
+    rank_k_asm_s16x6,
+    float, float, float, float>
+	(
+    w0, h0, d0, s, p, batchSize,
+    B,
+    w1, h1, d1,
+    A,
+    C,
+	  semiringkernel,
+	  microkernel,
+    layout
+	);
 };
 
 
 void conv2d
 (
+  hmlpLayout_t layout,
   int w0, int h0, int d0, int s, int p, int batchSize,
   double *B, int w1, int h1, int d1,
 	double *A,
@@ -68,54 +153,177 @@ void conv2d
     A,
     C,
 	  semiringkernel,
-	  microkernel
+	  microkernel,
+    layout
 	);
 };
 
 
+/** 
+ *  @brief Dispatch a convolution algorithm. Winograd falls back to the
+ *         implicit im2col path if the filters are not 3x3 with stride 1.
+ */ 
+template<typename T>
+void conv2d
+(
+  hmlpConvAlgorithm_t algorithm, hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  T *B, int w1, int h1, int d1,
+	T *A,
+	T *C
+)
+{
+  bool is_3x3 = ( w1 == 3 && h1 == 3 && s == 1 );
+  if ( algorithm == HMLP_CONV_AUTO ) 
+    algorithm = conv2d_select_algorithm<T>( w0, h0, d0, s, p, w1, h1, d1 );
+
+  if ( is_3x3 && algorithm == HMLP_CONV_WINOGRAD_F2X2 )
+    winograd_conv2d<2>( layout, w0, h0, d0, p, batchSize, B, d1, A, C, winograd_gemm() );
+  else if ( is_3x3 && algorithm == HMLP_CONV_WINOGRAD_F4X4 )
+    winograd_conv2d<4>( layout, w0, h0, d0, p, batchSize, B, d1, A, C, winograd_gemm() );
+  else
+    conv2d( layout, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
+
+
+void sconv2d
+(
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B, int w1, int h1, int d1,
+	float *A,
+	float *C
+)
+{
+  conv2d( HMLP_NHWC, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
+
+
+void dconv2d
+(
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B, int w1, int h1, int d1,
+	float *A,
+	float *C
+)
+{
+  conv2d( HMLP_NHWC, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
+
+
+void dconv2d
+(
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  double *B, int w1, int h1, int d1,
+	double *A,
+	double *C
+)
+{
+  conv2d( HMLP_NHWC, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
+
+
+void sconv2d
+(
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B, int w1, int h1, int d1,
+	float *A,
+	float *C
+)
+{
+  conv2d( layout, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
+
+
 void dconv2d
 (
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  double *B, int w1, int h1, int d1,
+	double *A,
+	double *C
+)
+{
+  conv2d( layout, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
+
+
+
+
+void sconv2d
+(
+  hmlpConvAlgorithm_t algorithm, hmlpLayout_t layout,
   int w0, int h0, int d0, int s, int p, int batchSize,
   float *B, int w1, int h1, int d1,
 	float *A,
 	float *C
 )
 {
-  conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+  conv2d( algorithm, layout, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
 };
 
 
 void dconv2d
 (
+  hmlpConvAlgorithm_t algorithm, hmlpLayout_t layout,
   int w0, int h0, int d0, int s, int p, int batchSize,
   double *B, int w1, int h1, int d1,
 	double *A,
 	double *C
 )
 {
-  conv2d( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+  conv2d( algorithm, layout, w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
+
+
+
+void sconv2d_ref
+(
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B, int w1, int h1, int d1,
+	float *A,
+	float *C
+)
+{
+  conv2d_ref( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
 };
 
 
+void dconv2d_ref
+(
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  double *B, int w1, int h1, int d1,
+	double *A,
+	double *C
+)
+{
+  conv2d_ref( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C );
+};
 
 
+void sconv2d_ref
+(
+  hmlpLayout_t layout,
+  int w0, int h0, int d0, int s, int p, int batchSize,
+  float *B, int w1, int h1, int d1,
+	float *A,
+	float *C
+)
+{
+  conv2d_ref( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C, layout );
+};
+
 
 void dconv2d_ref
 (
+  hmlpLayout_t layout,
   int w0, int h0, int d0, int s, int p, int batchSize,
   double *B, int w1, int h1, int d1,
 	double *A,
 	double *C
 )
 {
-  conv2d_ref
-  (
-    w0, h0, d0, s, p, batchSize,
-    B,
-    w1, h1, d1,
-    A,
-    C
- );
+  conv2d_ref( w0, h0, d0, s, p, batchSize, B, w1, h1, d1, A, C, layout );
 };
 
 
@@ -38,8 +38,25 @@ void strassen
 	float *C, int ldc
 )
 {
-  printf( "no implementation\n" );
-  exit( 1 );
+  rank_k_asm_s16x6 stra_semiringkernel;
+  rank_k_asm_s16x6 stra_microkernel;
+
+  strassen::strassen<
+    144, 2040, 256, 16, 6, 
+    144, 2040,     16, 6, 32,
+    false,
+    rank_k_asm_s16x6, 
+    rank_k_asm_s16x6,
+    float, float, float, float>
+	(
+    transA, transB,
+	  m, n, k,
+	  A, lda,
+	  B, ldb,
+	  C, ldc,
+	  stra_semiringkernel,
+	  stra_microkernel
+	);
 };
 
 void strassen
@@ -71,6 +88,31 @@ void strassen
 	  stra_microkernel
 	);
 
-}; 
+};
+
+
+void sstrassen
+(
+  hmlpOperation_t transA, hmlpOperation_t transB,
+	int m, int n, int k,
+	float *A, int lda,
+	float *B, int ldb,
+	float *C, int ldc
+)
+{
+  strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
+};
+
 
+void dstrassen
+(
+  hmlpOperation_t transA, hmlpOperation_t transB,
+	int m, int n, int k,
+	double *A, int lda,
+	double *B, int ldb,
+	double *C, int ldc
+)
+{
+  strassen( transA, transB, m, n, k, A, lda, B, ldb, C, ldc );
+};
 
@@ -60,6 +60,9 @@ export HMLP_CUDA_DIR=
 export HMLP_USE_MAGMA=false
 export HMLP_MAGMA_DIR=/users/chenhan/Projects/magma-2.2.0
 
+## NUMA-aware worker pinning and allocation (requires libnuma)
+export HMLP_USE_NUMA=false
+
 ## Output google site data
 export HMLP_ANALYSIS_DATA=false
 
@@ -176,6 +179,9 @@ echo "HMLP_CUDA_DIR = $HMLP_CUDA_DIR"
 echo "HMLP_USE_MAGMA = $HMLP_USE_MAGMA"
 echo "HMLP_MAGMA_DIR = $HMLP_MAGMA_DIR"
 
+## NUMA-aware worker pinning and allocation
+echo "HMLP_USE_NUMA = $HMLP_USE_NUMA"
+
 ## Output google site data
 echo "HMLP_ANALYSIS_DATA = $HMLP_ANALYSIS_DATA"
 
@@ -107,7 +107,7 @@ void test_conv2d
 ) 
 {
   T *A, *B, *C, *C_ref;
-  double ref_beg, ref_time, gkmx_beg, gkmx_time;
+  double ref_beg, ref_time, gkmx_beg, gkmx_time, auto_beg, auto_time;
 
   int n_iter = 3;
   int m = d1;
@@ -197,10 +197,32 @@ void test_conv2d
   ref_time = omp_get_wtime() - ref_beg;
   // ------------------------------------------------------------------------
 
+  // ------------------------------------------------------------------------
+  // Call the selected algorithm (Winograd for 3x3 stride-1 filters)
+  // ------------------------------------------------------------------------
+  T *C_auto = (T*)malloc( sizeof(T) * m * n * batchSize );
+  for ( auto iter = -1; iter < n_iter; iter ++ ) 
+  {
+    if ( iter == 0 ) auto_beg = omp_get_wtime();
+    dconv2d
+    (
+      HMLP_CONV_AUTO, HMLP_NHWC,
+      w0, h0, d0, s, p, batchSize,
+      B,
+      w1, h1, d1,
+      A,
+      C_auto
+    );
+  }
+  auto_time = omp_get_wtime() - auto_beg;
+  // ------------------------------------------------------------------------
+
   ref_time  /= n_iter;
   gkmx_time /= n_iter;
+  auto_time /= n_iter;
 
-  compute_error( m, n, C, m, C_ref, m );
+  compute_error( m, n * batchSize, C, m, C_ref, m );
+  compute_error( m, n * batchSize, C_auto, m, C_ref, m );
 
 #ifdef MATLAB_OUTPUT
   printf( "NN %5d, %5d, %5d, %5.2lf (%5.2lfms), %5.2lf (%5.2lfms);\n", 
@@ -209,6 +231,8 @@ void test_conv2d
   printf( "%5d, %5.2lf %5.2lfs, %5.2lf, %5.2lfs\n", 
       k, flops / gkmx_time, gkmx_time, flops / ref_time, ref_time );
 #endif
+  printf( "auto %5.2lf %5.2lfs\n", flops / auto_time, auto_time );
+  free( C_auto );
 
 
 
@@ -43,6 +43,7 @@
 #include <math.h>
 #include <hmlp.h>
 #include <hmlp_blas_lapack.h>
+#include <primitives/strassen.hpp>
 
 #ifdef HMLP_MIC_AVX512
 #include <hbwmalloc.h>
@@ -427,6 +428,19 @@ int main( int argc, char *argv[] )
   sscanf( argv[ 2 ], "%d", &n );
   sscanf( argv[ 3 ], "%d", &k );
 
+  /** Check the Brent equations of all coefficient tables. */
+  for ( auto &fmm : hmlp::strassen::FastMatMulCandidates() )
+  {
+    if ( !fmm.Verify() ) printf( "%s: wrong coefficients\n", fmm.name.c_str() );
+  }
+
+  int n_threads = hmlp_read_nway_from_env( "KS_JC_NT" )
+                * hmlp_read_nway_from_env( "KS_IC_NT" )
+                * hmlp_read_nway_from_env( "KS_JR_NT" );
+  auto fmm = hmlp::strassen::SelectFastMatMul<double>( m, n, k, n_threads );
+  printf( "selected %s <%d,%d,%d> rank %d\n", 
+      fmm.name.c_str(), fmm.mt, fmm.kt, fmm.nt, fmm.rank );
+
   test_strassen<double>( m, n, k );
 
   return 0;